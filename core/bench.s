@@ -0,0 +1,20 @@
+.global _bench_in_irq_mode
+
+.equ IRQ_MODE, 0b10010
+
+# Used by the micro-benchmarks (kernel/bench.c) to run code that swaps the
+# banked SVC/USR stack pointers, like c_scheduler() does.
+.section .text._bench
+
+// r0 = function, r1 = its argument
+// Calls the function in IRQ mode, on the IRQ stack, and returns its result
+// back in the caller's mode.
+_bench_in_irq_mode:
+    push {r4, lr}
+    mrs r4, cpsr
+    mov r2, r0
+    mov r0, r1
+    cps #IRQ_MODE
+    blx r2
+    msr cpsr_c, r4
+    pop {r4, pc}
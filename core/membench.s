@@ -0,0 +1,201 @@
+.global _mb_copy_word
+.global _mb_copy_ldm
+.global _mb_copy_neon
+.global _mb_scale_word
+.global _mb_scale_ldm
+.global _mb_scale_neon
+.global _mb_add_word
+.global _mb_add_ldm
+.global _mb_add_neon
+.global _mb_triad_word
+.global _mb_triad_ldm
+.global _mb_triad_neon
+.global _mb_fill_word
+.global _mb_fill_ldm
+.global _mb_fill_neon
+.global _mb_chase
+
+.arch armv7-a
+.fpu neon
+
+# Has to match MEMBENCH_Q (kernel/inc/membench.h)
+.equ MB_Q, 3
+
+# Memory bandwidth kernels (kernel/membench.c), one per access width: a word
+# per ldr/str, 4-8 words per ldm/stm, 32 bytes per vld1/vst1. They run in USR
+# mode from the user tasks, so they live in the shared user library.
+# STREAM kernels: r0 = dst, r1 = a, r2 = b, r3 = bytes (a multiple of 32)
+.section .ulib.text._membench, "ax"
+
+// dst[i] = a[i]
+_mb_copy_word:
+    ldr r12, [r1], #4
+    str r12, [r0], #4
+    subs r3, r3, #4
+    bne _mb_copy_word
+    bx lr
+
+_mb_copy_ldm:
+    push {r4-r11}
+1:  ldmia r1!, {r4-r11}
+    stmia r0!, {r4-r11}
+    subs r3, r3, #32
+    bne 1b
+    pop {r4-r11}
+    bx lr
+
+_mb_copy_neon:
+    vld1.32 {d0-d3}, [r1]!
+    vst1.32 {d0-d3}, [r0]!
+    subs r3, r3, #32
+    bne _mb_copy_neon
+    bx lr
+
+// dst[i] = MB_Q * a[i]
+_mb_scale_word:
+    mov r2, #MB_Q
+1:  ldr r12, [r1], #4
+    mul r12, r12, r2
+    str r12, [r0], #4
+    subs r3, r3, #4
+    bne 1b
+    bx lr
+
+_mb_scale_ldm:
+    push {r4-r7}
+    mov r2, #MB_Q
+1:  ldmia r1!, {r4-r7}
+    mul r4, r4, r2
+    mul r5, r5, r2
+    mul r6, r6, r2
+    mul r7, r7, r2
+    stmia r0!, {r4-r7}
+    subs r3, r3, #16
+    bne 1b
+    pop {r4-r7}
+    bx lr
+
+_mb_scale_neon:
+    mov r2, #MB_Q
+    vdup.32 q8, r2
+1:  vld1.32 {d0-d3}, [r1]!
+    vmul.i32 q0, q0, q8
+    vmul.i32 q1, q1, q8
+    vst1.32 {d0-d3}, [r0]!
+    subs r3, r3, #32
+    bne 1b
+    bx lr
+
+// dst[i] = a[i] + b[i]
+_mb_add_word:
+    push {r4, lr}
+1:  ldr r12, [r1], #4
+    ldr r4, [r2], #4
+    add r12, r12, r4
+    str r12, [r0], #4
+    subs r3, r3, #4
+    bne 1b
+    pop {r4, pc}
+
+_mb_add_ldm:
+    push {r4-r11}
+1:  ldmia r1!, {r4-r7}
+    ldmia r2!, {r8-r11}
+    add r4, r4, r8
+    add r5, r5, r9
+    add r6, r6, r10
+    add r7, r7, r11
+    stmia r0!, {r4-r7}
+    subs r3, r3, #16
+    bne 1b
+    pop {r4-r11}
+    bx lr
+
+_mb_add_neon:
+    vld1.32 {d0-d3}, [r1]!
+    vld1.32 {d4-d7}, [r2]!
+    vadd.i32 q0, q0, q2
+    vadd.i32 q1, q1, q3
+    vst1.32 {d0-d3}, [r0]!
+    subs r3, r3, #32
+    bne _mb_add_neon
+    bx lr
+
+// dst[i] = a[i] + MB_Q * b[i]
+_mb_triad_word:
+    push {r4, r5}
+    mov r5, #MB_Q
+1:  ldr r12, [r1], #4
+    ldr r4, [r2], #4
+    mla r12, r4, r5, r12
+    str r12, [r0], #4
+    subs r3, r3, #4
+    bne 1b
+    pop {r4, r5}
+    bx lr
+
+_mb_triad_ldm:
+    push {r4-r11}
+    mov r12, #MB_Q
+1:  ldmia r1!, {r4-r7}
+    ldmia r2!, {r8-r11}
+    mla r4, r8, r12, r4
+    mla r5, r9, r12, r5
+    mla r6, r10, r12, r6
+    mla r7, r11, r12, r7
+    stmia r0!, {r4-r7}
+    subs r3, r3, #16
+    bne 1b
+    pop {r4-r11}
+    bx lr
+
+_mb_triad_neon:
+    mov r12, #MB_Q
+    vdup.32 q8, r12
+1:  vld1.32 {d0-d3}, [r1]!
+    vld1.32 {d4-d7}, [r2]!
+    vmla.i32 q0, q2, q8
+    vmla.i32 q1, q3, q8
+    vst1.32 {d0-d3}, [r0]!
+    subs r3, r3, #32
+    bne 1b
+    bx lr
+
+// r0 = dst, r1 = pattern, r2 = bytes (a multiple of 32)
+_mb_fill_word:
+    str r1, [r0], #4
+    subs r2, r2, #4
+    bne _mb_fill_word
+    bx lr
+
+_mb_fill_ldm:
+    push {r4-r9}
+    mov r3, r1
+    mov r4, r1
+    mov r5, r1
+    mov r6, r1
+    mov r7, r1
+    mov r8, r1
+    mov r9, r1
+1:  stmia r0!, {r1, r3-r9}
+    subs r2, r2, #32
+    bne 1b
+    pop {r4-r9}
+    bx lr
+
+_mb_fill_neon:
+    vdup.32 q0, r1
+    vmov q1, q0
+1:  vst1.32 {d0-d3}, [r0]!
+    subs r2, r2, #32
+    bne 1b
+    bx lr
+
+// r0 = first element, r1 = count
+// Follows the chain of pointers count times, every load depends on the
+// previous one. Returns the last element reached.
+_mb_chase:
+    ldr r0, [r0]
+    subs r1, r1, #1
+    bne _mb_chase
+    bx lr
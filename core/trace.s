@@ -0,0 +1,18 @@
+.global _trace_entry
+
+.extern c_trace_hit
+
+# Target of the enabled tracepoints (kernel/inc/trace.h), reached through a
+# patched `bl`: lr is the instruction after the tracepoint, r0 its argument.
+# It runs in whatever mode the tracepoint was hit in, and keeps every
+# register and the flags but lr.
+.section .text._trace
+
+_trace_entry:
+    push {r0-r5, r12, lr}
+    mrs r4, cpsr
+    sub r1, lr, #4
+    bl c_trace_hit
+    msr cpsr_f, r4
+    pop {r0-r5, r12, lr}
+    bx lr
@@ -5,6 +5,9 @@
 .section .text._undefined_handler
 _undefined_handler:
     push {r0-r5, ip, lr}
+    sub r0, lr, #4          // Address of the undefined instruction (ARM state)
     bl c_undefined_handler
+    cmp r0, #0              // Non zero: retry the instruction (lazy VFP)
     pop {r0-r5, ip, lr}
+    subne lr, lr, #4
     movs pc, lr
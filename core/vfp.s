@@ -0,0 +1,52 @@
+.global _vfp_enable
+.global _vfp_disable
+.global _vfp_is_enabled
+.global _vfp_save
+.global _vfp_restore
+
+.arch armv7-a
+.fpu neon
+
+.equ FPEXC_EN, 0x40000000
+
+# Following:
+# - https://developer.arm.com/documentation/den0013/d/Floating-Point/Floating-point-basics-and-the-IEEE-754-standard/Enabling-VFP
+# - https://developer.arm.com/documentation/ddi0406/c/System-Level-Architecture/The-Floating-point--FP--and-Advanced-SIMD-Extensions/FP-and-Advanced-SIMD-system-registers/FPEXC--Floating-Point-Exception-Control-register
+.section .text._vfp
+
+// Set FPEXC.EN, VFP/NEON instructions stop trapping
+_vfp_enable:
+    vmrs r0, fpexc
+    orr r0, r0, #FPEXC_EN
+    vmsr fpexc, r0
+    bx lr
+
+// Clear FPEXC.EN, the next VFP/NEON instruction traps into _undefined_handler
+_vfp_disable:
+    vmrs r0, fpexc
+    bic r0, r0, #FPEXC_EN
+    vmsr fpexc, r0
+    bx lr
+
+// r0 = 1 if FPEXC.EN is set
+_vfp_is_enabled:
+    vmrs r0, fpexc
+    lsr r0, r0, #30
+    and r0, r0, #1
+    bx lr
+
+// r0 = _vfp_ctx_t *, saves d0-d31 and FPSCR
+_vfp_save:
+    vstmia r0!, {d0-d15}
+    vstmia r0!, {d16-d31}
+    vmrs r1, fpscr
+    str r1, [r0]
+    bx lr
+
+// r0 = _vfp_ctx_t *, restores d0-d31 and FPSCR
+_vfp_restore:
+    vldmia r0!, {d0-d15}
+    vldmia r0!, {d16-d31}
+    ldr r1, [r0]
+    vmsr fpscr, r1
+    bx lr
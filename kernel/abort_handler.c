@@ -1,18 +1,43 @@
 #include "../sys/inc/logger.h"
 #include "inc/mmu.h"
+#include "inc/sched.h"
+#include "inc/stack.h"
+#include "inc/vm.h"
 
 __attribute__((section(".text._abort_handler"))) uint32_t c_abort_handler() {
-  c_log_warn("Abort Handler");
   // Get the fault address from DFAR
   // # Following:
   // -
   // https://developer.arm.com/documentation/ddi0406/c/System-Level-Architecture/System-Control-Registers-in-a-PMSA-implementation/PMSA-System-control-registers-descriptions--in-register-order/DFAR--Data-Fault-Address-Register--PMSA
   uint32_t fault_addr;
   __asm__ volatile("mrc p15, 0, %0, c6, c0, 0" : "=r"(fault_addr));
+
+  // Write to a page shared copy-on-write: DFSR.FS = 0b01111 (permission
+  // fault on a page) with WnR set. The access is retried on return.
+  uint32_t dfsr;
+  __asm__ volatile("mrc p15, 0, %0, c5, c0, 0" : "=r"(dfsr));
+  uint32_t status = (dfsr & 0xF) | ((dfsr >> 6) & 0x10);
+  if (status == 0xF && (dfsr & (1 << 11)) &&
+      c_vm_cow_fault(fault_addr) == PAGING_SUCCESS) {
+    return 0;
+  }
+
+  c_log_warn("Abort Handler");
   c_log_warn("Abort Handler at address");
   c_puts_hex(fault_addr);
   c_putchar('\n');
 
+  // Stack overflow into the guard page: stop the task and let the others run.
+  // Until the reschedule SGI is taken the access just faults again.
+  _task_t *task = c_task_current();
+  if (c_stack_guard_hit(task, fault_addr)) {
+    c_log_error("Stack overflow, stopping task");
+    c_puts_hex(task->id);
+    c_putchar('\n');
+    c_task_stop();
+    return 0;
+  }
+
   while (1) {
     asm("wfi");
   }
@@ -0,0 +1,92 @@
+#include "inc/arena.h"
+#include "inc/syscall.h"
+#include "inc/vm.h"
+#include <stddef.h>
+
+// Runs in USR mode from the user tasks: only system calls, no kernel calls.
+
+__attribute__((section(".ulib.text"))) void arena_init(_arena_t *arena) {
+  for (uint32_t i = 0; i < ARENA_CLASSES; i++) {
+    arena->free[i] = NULL;
+  }
+  arena->large = NULL;
+  arena->top = SYSCALL1(SYS_BRK, 0);
+  arena->end = arena->top;
+  arena->allocs = 0;
+  arena->frees = 0;
+  arena->syscalls = 1;
+}
+
+__attribute__((section(".ulib.text"))) static void *
+arena_alloc_large(_arena_t *arena, uint32_t size) {
+  uint32_t pages = (size + ARENA_HEADER + 0xFFF) >> 12;
+  _arena_block_t **prev = &arena->large;
+
+  for (_arena_block_t *blk = arena->large; blk != NULL; blk = blk->next) {
+    if ((blk->info & ~ARENA_LARGE) >= pages) {
+      *prev = blk->next;
+      return (uint8_t *)blk + ARENA_HEADER;
+    }
+    prev = &blk->next;
+  }
+
+  arena->syscalls++;
+  uint32_t va = SYSCALL1(SYS_MMAP, pages << 12);
+  if (va == VM_MAP_FAILED) {
+    return NULL;
+  }
+  _arena_block_t *blk = (_arena_block_t *)va;
+  blk->info = ARENA_LARGE | pages;
+  return (uint8_t *)blk + ARENA_HEADER;
+}
+
+__attribute__((section(".ulib.text"))) void *arena_alloc(_arena_t *arena,
+                                                         uint32_t size) {
+  if (size > ARENA_MAX_SMALL - ARENA_HEADER) {
+    void *ptr = arena_alloc_large(arena, size);
+    if (ptr != NULL) {
+      arena->allocs++;
+    }
+    return ptr;
+  }
+
+  uint32_t cls = 0;
+  while ((1u << (ARENA_MIN_SHIFT + cls)) < size + ARENA_HEADER) {
+    cls++;
+  }
+  _arena_block_t *blk = arena->free[cls];
+  if (blk != NULL) {
+    arena->free[cls] = blk->next;
+  } else {
+    uint32_t block_size = 1u << (ARENA_MIN_SHIFT + cls);
+    if (arena->top + block_size > arena->end) {
+      arena->syscalls++;
+      uint32_t end = SYSCALL1(SYS_BRK, arena->end + ARENA_GROW);
+      if (end == arena->end) {
+        return NULL;
+      }
+      arena->end = end;
+    }
+    blk = (_arena_block_t *)arena->top;
+    arena->top += block_size;
+  }
+  blk->info = cls;
+  arena->allocs++;
+  return (uint8_t *)blk + ARENA_HEADER;
+}
+
+__attribute__((section(".ulib.text"))) void arena_free(_arena_t *arena,
+                                                       void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  _arena_block_t *blk = (_arena_block_t *)((uint8_t *)ptr - ARENA_HEADER);
+  if (blk->info & ARENA_LARGE) {
+    blk->next = arena->large;
+    arena->large = blk;
+  } else {
+    blk->next = arena->free[blk->info];
+    arena->free[blk->info] = blk;
+  }
+  arena->frees++;
+}
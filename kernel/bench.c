@@ -0,0 +1,179 @@
+#include "inc/bench.h"
+#include "../sys/inc/logger.h"
+#include "inc/gic.h"
+#include "inc/mmu.h"
+#include "inc/pmu.h"
+#include "inc/rs.h"
+#include "inc/sched.h"
+#include "inc/semihost.h"
+#include "inc/syscall.h"
+#include "inc/uart.h"
+
+#ifdef CONFIG_BENCH
+extern mmu_tables_t mmu_tables[MAX_TASKS];
+
+static volatile uint32_t bench_irq_count = 0;
+
+__attribute__((section(".kernel.text"))) static void
+bench_report(const char *name, uint32_t iterations, uint32_t cycles) {
+  c_puts("BENCH ");
+  c_puts(name);
+  c_putchar(' ');
+  c_puts_hex(iterations);
+  c_putchar(' ');
+  c_puts_hex(cycles);
+  c_putchar('\n');
+}
+
+// Runs from the boot region, the kernel sections are copied again each time
+__attribute__((section(".text"))) static uint32_t bench_copy_sections(void) {
+  uint32_t start = pmu_cycles();
+  for (uint32_t i = 0; i < BENCH_SLOW_ITERATIONS; i++) {
+    copy_sections();
+  }
+  return pmu_cycles() - start;
+}
+
+// Maps BENCH_MAP_SIZE bytes into the idle task's tables, which are cleared
+// by c_mmu_fill_tables() afterwards. Dropping the L1 entry makes every run
+// allocate and clear its L2 table again.
+__attribute__((section(".kernel.text"))) static uint32_t
+bench_map_region(void) {
+  mmu_tables_t *tables = &mmu_tables[0];
+  uint32_t cycles = 0;
+
+  for (uint32_t i = 0; i < BENCH_SLOW_ITERATIONS; i++) {
+    tables->l1_table[BENCH_MAP_VA >> 20] = 0;
+    tables->next_l2_table = 0;
+
+    uint32_t start = pmu_cycles();
+    map_region(tables, BENCH_MAP_VA, BENCH_MAP_VA, BENCH_MAP_SIZE,
+               L2_DEFAULT_FLAGS);
+    cycles += pmu_cycles() - start;
+  }
+  tables->l1_table[BENCH_MAP_VA >> 20] = 0;
+  tables->next_l2_table = 0;
+  return cycles;
+}
+
+// Same mapping as bench_map_region(), through c_mmu_map_batch()
+__attribute__((section(".kernel.text"))) static uint32_t bench_map_batch(void) {
+  mmu_tables_t *tables = &mmu_tables[0];
+  _mmu_map_t map;
+  uint32_t cycles = 0;
+
+  map.va = BENCH_MAP_VA;
+  map.pa = BENCH_MAP_VA;
+  map.size = BENCH_MAP_SIZE;
+  map.flags = L2_DEFAULT_FLAGS;
+  for (uint32_t i = 0; i < BENCH_SLOW_ITERATIONS; i++) {
+    tables->l1_table[BENCH_MAP_VA >> 20] = 0;
+    tables->next_l2_table = 0;
+
+    uint32_t start = pmu_cycles();
+    c_mmu_map_batch(tables, &map, 1);
+    cycles += pmu_cycles() - start;
+  }
+  tables->l1_table[BENCH_MAP_VA >> 20] = 0;
+  tables->next_l2_table = 0;
+  return cycles;
+}
+
+__attribute__((section(".kernel.text"))) static uint32_t bench_syscall(void) {
+  uint32_t start = pmu_cycles();
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    SYSCALL0(SYS_NOP);
+  }
+  return pmu_cycles() - start;
+}
+
+// Raises BENCH_SGI and waits for its handler, with the timer masked so it
+// does not start the scheduler.
+__attribute__((section(".kernel.text"))) static uint32_t bench_irq(void) {
+  _gicd_t *const GICD0 = (_gicd_t *)GICD0_ADDR;
+
+  GICD0->ICENABLER[GIC_ENABLE_REG(GIC_SOURCE_TICK)] =
+      GIC_ENABLE_BIT(GIC_SOURCE_TICK);
+  GICD0->ISENABLER[0] = 1 << BENCH_SGI;
+  bench_irq_count = 0;
+
+  uint32_t start = pmu_cycles();
+  asm volatile("cpsie i");
+  for (uint32_t i = 1; i <= BENCH_ITERATIONS; i++) {
+    GICD0->SGIR = GICD_SGIR_TARGET_SELF | BENCH_SGI;
+    while (bench_irq_count != i) {
+    }
+  }
+  asm volatile("cpsid i");
+  uint32_t cycles = pmu_cycles() - start;
+
+  GICD0->ISENABLER[GIC_ENABLE_REG(GIC_SOURCE_TICK)] =
+      GIC_ENABLE_BIT(GIC_SOURCE_TICK);
+  return cycles;
+}
+
+#ifdef CONFIG_RS
+static const char bench_uart_line[] =
+    "BENCH_UART ------------------------------------------------------\n";
+
+// Polling C driver, spins on FR_TXFF
+__attribute__((section(".kernel.text"))) static uint32_t bench_uart_poll(void) {
+  uint32_t start = pmu_cycles();
+  for (uint32_t i = 0; i < BENCH_SLOW_ITERATIONS; i++) {
+    c_puts(bench_uart_line);
+  }
+  return pmu_cycles() - start;
+}
+
+// Same output through the Rust executor and the async UART write future,
+// with the timer masked as in bench_irq()
+__attribute__((section(".kernel.text"))) static uint32_t
+bench_uart_async(void) {
+  _gicd_t *const GICD0 = (_gicd_t *)GICD0_ADDR;
+
+  GICD0->ICENABLER[GIC_ENABLE_REG(GIC_SOURCE_TICK)] =
+      GIC_ENABLE_BIT(GIC_SOURCE_TICK);
+  uint32_t start = pmu_cycles();
+  asm volatile("cpsie i");
+  rs_uart_bench(bench_uart_line, sizeof(bench_uart_line) - 1,
+                BENCH_SLOW_ITERATIONS);
+  asm volatile("cpsid i");
+  uint32_t cycles = pmu_cycles() - start;
+
+  GICD0->ISENABLER[GIC_ENABLE_REG(GIC_SOURCE_TICK)] =
+      GIC_ENABLE_BIT(GIC_SOURCE_TICK);
+  return cycles;
+}
+#endif
+
+__attribute__((section(".kernel.text"))) void c_bench_irq(void) {
+  bench_irq_count++;
+}
+
+__attribute__((section(".text"))) void c_bench_early(void) {
+  pmu_init();
+  c_log_info("Running the pre-MMU benchmarks...");
+
+  bench_report("copy_sections", BENCH_SLOW_ITERATIONS, bench_copy_sections());
+  bench_report("map_region", BENCH_SLOW_ITERATIONS, bench_map_region());
+  bench_report("map_batch", BENCH_SLOW_ITERATIONS, bench_map_batch());
+}
+
+__attribute__((section(".kernel.text"))) void c_bench_late(void) {
+  c_log_info("Running the benchmarks...");
+
+  bench_report("syscall", BENCH_ITERATIONS, bench_syscall());
+  bench_report("irq", BENCH_ITERATIONS, bench_irq());
+  bench_report("ctx_switch", BENCH_ITERATIONS,
+               _bench_in_irq_mode(c_scheduler_bench, BENCH_ITERATIONS));
+#ifdef CONFIG_RS
+  bench_report("uart_poll", BENCH_SLOW_ITERATIONS, bench_uart_poll());
+  bench_report("uart_async", BENCH_SLOW_ITERATIONS, bench_uart_async());
+#endif
+  c_putsln("BENCH done");
+
+  c_semihost_exit(ADP_STOPPED_APPLICATION_EXIT);
+  // Only reached without -semihosting
+  c_log_warn("Semihosting exit failed, starting the scheduler");
+}
+#endif
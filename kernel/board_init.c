@@ -1,25 +1,44 @@
 #include "../sys/inc/logger.h"
+#include "inc/bench.h"
+#include "inc/clock.h"
+#include "inc/dma.h"
 #include "inc/gic.h"
 #include "inc/mmu.h"
+#include "inc/page.h"
 #include "inc/sched.h"
+#include "inc/swtimer.h"
 #include "inc/tasks.h"
 #include "inc/timer.h"
 #include "inc/uart.h"
+#include "inc/vfp.h"
 
 __attribute__((section(".text"))) void c_board_init(void) {
   copy_sections();
   c_gic_init();
+  c_dma_init();
+  c_page_init();
   c_timer_init();
+  c_clock_init();
+  c_swtimer_wheel_init();
+  // VFP/NEON enabled lazily, on the first FP instruction of each task
+  c_vfp_init();
 
   // Seems that the initialization is not necessary
   // on Realview pb8
   // Init UART
   c_UART0_init();
+#ifdef CONFIG_BENCH
+  c_bench_early();
+#endif
   c_log_info("Starting Scheduler...");
 
   // Init Tasks / Scheduler
   // It also fills the tables needed to start the MMU
   c_scheduler_init();
+#ifdef CONFIG_BENCH
+  c_bench_late();
+#endif
+  c_scheduler_start();
 
   c_putsln("Should not reach here");
   return;
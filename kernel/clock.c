@@ -0,0 +1,42 @@
+#include "inc/clock.h"
+
+// Own page, so it can be mapped read-only for the tasks (linker/mmap.ld)
+_clock_page_t clock_page
+    __attribute__((section(".clock_page"), aligned(0x1000)));
+
+__attribute__((section(".kernel.text"))) void c_clock_init(void) {
+#ifdef BOARD_TIMER_SP804
+  _timer_t *const TIMER0 = (_timer_t *)TIMER0_ADDR;
+
+  // Free-running mode reloads 0xFFFFFFFF when the count reaches zero
+  TIMER0->Timer2Ctrl = 0;
+  TIMER0->Timer2Load = 0xFFFFFFFF;
+  // Set to 32-bit counter, no interrupt, no prescaler
+  TIMER0->Timer2Ctrl = 0x00000002;
+  // Timer Enabled
+  TIMER0->Timer2Ctrl |= CTRL_IRQ_ENABLE;
+#else
+  _gtimer_t *const GTIMER = (_gtimer_t *)GTIMER_ADDR;
+
+  // The counter is only writable while the timer is disabled
+  GTIMER->Control = 0;
+  GTIMER->CounterLo = 0;
+  GTIMER->CounterHi = 0;
+  GTIMER->Control = A9_TIMER_PRESCALER(TIMER_PRESCALER) | A9_TIMER_ENABLE;
+#endif
+
+  clock_page.seq = 0;
+  clock_page.base = 0;
+  clock_page.last = clock_read_raw();
+}
+
+// Called from c_systick_handler(), with IRQs disabled
+__attribute__((section(".kernel.text"))) void c_clock_update(void) {
+  clock_page.seq++;
+  asm volatile("dmb" ::: "memory");
+  uint32_t raw = clock_read_raw();
+  clock_page.base += (uint32_t)(raw - clock_page.last);
+  clock_page.last = raw;
+  asm volatile("dmb" ::: "memory");
+  clock_page.seq++;
+}
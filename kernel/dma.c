@@ -0,0 +1,360 @@
+#include "inc/dma.h"
+#include "inc/gic.h"
+#include "inc/irq.h"
+#include "inc/sched.h"
+#include "inc/softirq.h"
+#include "inc/uart.h"
+
+// dma_prepare() flags
+#define DMA_USER (1 << 0u)      // Check the source against user permissions
+#define DMA_FIXED_DST (1 << 1u) // dst is a peripheral register, no increment
+
+#ifdef BOARD_HAS_DMA
+typedef struct {
+  // The controller only reads the LLIs, the first one is copied into the
+  // channel registers by dma_start()
+  _dma_lli_t lli[DMA_MAX_LLI];
+  uint32_t busy;
+  _dma_callback_t callback;
+  void *arg;
+} _dma_channel_t;
+
+// Kept in .bss, which is identity mapped, so the LLI addresses can be handed
+// to the controller as they are
+static _dma_channel_t dma_channels[DMA_CHANNELS];
+// Channels completed (or failed) since the last dma_softirq()
+static volatile uint32_t dma_done_tc = 0;
+static volatile uint32_t dma_done_err = 0;
+
+__attribute__((section(".kernel.text"))) static void dma_softirq(void);
+#endif
+
+#define DMA_ATS_PRIV_READ 0  // ATS1CPR
+#define DMA_ATS_PRIV_WRITE 1 // ATS1CPW
+#define DMA_ATS_USER_READ 2  // ATS1CUR
+
+// Address translation with the current task's tables.
+// ATS1CUR checks USR read permissions, ATS1CPR/ATS1CPW the privileged ones.
+// Returns 1 and the physical address, or 0 if the translation faults.
+static inline uint32_t dma_pa(uintptr_t va, uint32_t op, uint32_t *pa) {
+  uint32_t par;
+  if (op == DMA_ATS_PRIV_READ) {
+    asm volatile("mcr p15, 0, %0, c7, c8, 0" ::"r"(va));
+  } else if (op == DMA_ATS_PRIV_WRITE) {
+    asm volatile("mcr p15, 0, %0, c7, c8, 1" ::"r"(va));
+  } else {
+    asm volatile("mcr p15, 0, %0, c7, c8, 2" ::"r"(va));
+  }
+  asm volatile("isb\n\t"
+               "mrc p15, 0, %0, c7, c4, 0"
+               : "=r"(par));
+  // PAR.F
+  if (par & 0x1) {
+    return 0;
+  }
+  *pa = (par & 0xFFFFF000) | (va & 0xFFF);
+  return 1;
+}
+
+#ifdef BOARD_HAS_DMA
+__attribute__((section(".kernel.text"))) void c_dma_init(void) {
+  _dma_t *const DMA = (_dma_t *)DMA_ADDR;
+
+  for (uint32_t i = 0; i < DMA_CHANNELS; i++) {
+    DMA->Channel[i].Configuration = 0;
+    dma_channels[i].busy = 0;
+  }
+  DMA->IntTCClear = 0xFF;
+  DMA->IntErrClr = 0xFF;
+  // Both AHB masters little-endian
+  DMA->Configuration = DMA_CONFIG_E;
+
+  c_softirq_register(SOFTIRQ_DMA, dma_softirq);
+  c_gic_enable(GIC_SOURCE_DMA);
+}
+
+__attribute__((section(".kernel.text"))) int32_t c_dma_chan_alloc(void) {
+  uint32_t flags = irq_save();
+  for (uint32_t i = 0; i < DMA_CHANNELS; i++) {
+    if (!dma_channels[i].busy) {
+      dma_channels[i].busy = 1;
+      irq_restore(flags);
+      return i;
+    }
+  }
+  irq_restore(flags);
+  return DMA_ERROR_BUSY;
+}
+
+__attribute__((section(".kernel.text"))) void c_dma_chan_free(uint32_t chan) {
+  _dma_t *const DMA = (_dma_t *)DMA_ADDR;
+
+  DMA->Channel[chan].Configuration = 0;
+  dma_channels[chan].callback = NULL;
+  dma_channels[chan].busy = 0;
+}
+
+// Splits the buffers into physically contiguous chunks, one LLI each.
+// A chunk ends at a page boundary of either buffer or at DMA_MAX_TRANSFER.
+__attribute__((section(".kernel.text"))) static int32_t
+dma_prepare(uint32_t chan, uintptr_t dst, uintptr_t src, uint32_t size,
+            uint32_t flags) {
+  _dma_lli_t *lli = dma_channels[chan].lli;
+  uint32_t src_op = (flags & DMA_USER) ? DMA_ATS_USER_READ : DMA_ATS_PRIV_READ;
+  uint32_t count = 0;
+
+  if (size == 0) {
+    return DMA_ERROR_SIZE;
+  }
+
+  while (size > 0) {
+    if (count == DMA_MAX_LLI) {
+      return DMA_ERROR_SIZE;
+    }
+
+    uint32_t chunk = 0x1000 - (src & 0xFFF);
+    if (!(flags & DMA_FIXED_DST) && 0x1000 - (dst & 0xFFF) < chunk) {
+      chunk = 0x1000 - (dst & 0xFFF);
+    }
+    if (size < chunk) {
+      chunk = size;
+    }
+
+    uint32_t src_pa, dst_pa = dst;
+    if (!dma_pa(src, src_op, &src_pa)) {
+      return DMA_ERROR_FAULT;
+    }
+    if (!(flags & DMA_FIXED_DST) &&
+        !dma_pa(dst, DMA_ATS_PRIV_WRITE, &dst_pa)) {
+      return DMA_ERROR_FAULT;
+    }
+
+    // Word transfers when both ends allow it, a page is at most 1024 words
+    uint32_t control;
+    if (!(flags & DMA_FIXED_DST) && ((src_pa | dst_pa | chunk) & 0x3) == 0) {
+      control = DMA_CTRL_SIZE(chunk >> 2) | DMA_CTRL_SWIDTH(DMA_WIDTH_WORD) |
+                DMA_CTRL_DWIDTH(DMA_WIDTH_WORD);
+    } else {
+      if (chunk > DMA_MAX_TRANSFER) {
+        chunk = DMA_MAX_TRANSFER;
+      }
+      control = DMA_CTRL_SIZE(chunk) | DMA_CTRL_SWIDTH(DMA_WIDTH_BYTE) |
+                DMA_CTRL_DWIDTH(DMA_WIDTH_BYTE);
+    }
+    control |= DMA_CTRL_SBSIZE(DMA_BURST_4) | DMA_CTRL_DBSIZE(DMA_BURST_4) |
+               DMA_CTRL_SI;
+    if (!(flags & DMA_FIXED_DST)) {
+      control |= DMA_CTRL_DI;
+    }
+
+    lli[count].src = src_pa;
+    lli[count].dst = dst_pa;
+    lli[count].next = 0;
+    lli[count].control = control;
+    if (count > 0) {
+      lli[count - 1].next = (uint32_t)&lli[count];
+    }
+    count++;
+
+    src += chunk;
+    if (!(flags & DMA_FIXED_DST)) {
+      dst += chunk;
+    }
+    size -= chunk;
+  }
+
+  // Only the last item raises the terminal count interrupt
+  lli[count - 1].control |= DMA_CTRL_I;
+  return DMA_SUCCESS;
+}
+
+__attribute__((section(".kernel.text"))) static void dma_start(uint32_t chan) {
+  _dma_t *const DMA = (_dma_t *)DMA_ADDR;
+  _dma_lli_t *lli = dma_channels[chan].lli;
+
+  DMA->Channel[chan].SrcAddr = lli[0].src;
+  DMA->Channel[chan].DestAddr = lli[0].dst;
+  DMA->Channel[chan].LLI = lli[0].next;
+  DMA->Channel[chan].Control = lli[0].control;
+  DMA->Channel[chan].Configuration =
+      DMA_CH_FLOW_M2M | DMA_CH_IE | DMA_CH_ITC | DMA_CH_E;
+}
+
+__attribute__((section(".kernel.text"))) static int32_t
+dma_submit(uintptr_t dst, const void *src, uint32_t size, uint32_t flags,
+           _dma_callback_t callback, void *arg) {
+  int32_t chan = c_dma_chan_alloc();
+  if (chan < 0) {
+    return chan;
+  }
+
+  int32_t ret = dma_prepare(chan, dst, (uintptr_t)src, size, flags);
+  if (ret != DMA_SUCCESS) {
+    c_dma_chan_free(chan);
+    return ret;
+  }
+  dma_channels[chan].callback = callback;
+  dma_channels[chan].arg = arg;
+  dma_start(chan);
+  return chan;
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_memcpy_async(void *dst, const void *src, uint32_t size,
+                   _dma_callback_t callback, void *arg) {
+  return dma_submit((uintptr_t)dst, src, size, 0, callback, arg);
+}
+
+// QEMU's PL080 does not implement the peripheral request lines, so the
+// transfer is memory-to-memory into UART0 DR and relies on the PL011 model
+// never filling its FIFO.
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_uart_write_async(const void *buf, uint32_t size,
+                       _dma_callback_t callback, void *arg) {
+  _uart_t *const UART0 = (_uart_t *)UART0_ADDR;
+  return dma_submit((uintptr_t)&UART0->DR, buf, size, DMA_FIXED_DST, callback,
+                    arg);
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_uart_write_user_async(const void *buf, uint32_t size,
+                            _dma_callback_t callback, void *arg) {
+  _uart_t *const UART0 = (_uart_t *)UART0_ADDR;
+  return dma_submit((uintptr_t)&UART0->DR, buf, size, DMA_USER | DMA_FIXED_DST,
+                    callback, arg);
+}
+
+// The task returned `size` from SYS_UART_WRITE and has been switched out
+// since, a failed transfer hands it the status instead
+__attribute__((section(".kernel.text"))) static void
+dma_wake_task(void *arg, int32_t status) {
+  _task_t *task = (_task_t *)arg;
+
+  uint32_t cpsr = irq_save();
+  if (status != DMA_SUCCESS) {
+    c_task_set_result(task, (uint32_t)status);
+  }
+  c_task_wake((uintptr_t)task, 1);
+  irq_restore(cpsr);
+}
+
+// Called from the SWI handler with IRQs masked, so the completion cannot
+// be handled before the task is marked blocked.
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_uart_write(const void *buf, uint32_t size) {
+  _uart_t *const UART0 = (_uart_t *)UART0_ADDR;
+
+  int32_t chan = c_dma_chan_alloc();
+  if (chan < 0) {
+    return chan;
+  }
+  int32_t ret = dma_prepare(chan, (uintptr_t)&UART0->DR, (uintptr_t)buf, size,
+                            DMA_USER | DMA_FIXED_DST);
+  if (ret != DMA_SUCCESS) {
+    c_dma_chan_free(chan);
+    return ret;
+  }
+
+  // The task itself is the wait key, kernel memory is never a futex key. The
+  // channel is freed before the callback runs, so it cannot hold the task.
+  _task_t *task = c_task_current();
+  dma_channels[chan].callback = dma_wake_task;
+  dma_channels[chan].arg = task;
+  c_task_block((uintptr_t)task, SCHED_NO_HINT);
+  dma_start(chan);
+  return size;
+}
+
+// Top half: acknowledges the controller, the callbacks run from
+// dma_softirq()
+__attribute__((section(".kernel.text"))) void c_dma_irq(void) {
+  _dma_t *const DMA = (_dma_t *)DMA_ADDR;
+
+  uint32_t tc = DMA->IntTCStatus;
+  uint32_t err = DMA->IntErrorStatus;
+  DMA->IntTCClear = tc;
+  DMA->IntErrClr = err;
+  dma_done_tc |= tc;
+  dma_done_err |= err;
+  c_softirq_raise(SOFTIRQ_DMA);
+}
+
+// SOFTIRQ_DMA, runs in the kworker with IRQs enabled
+__attribute__((section(".kernel.text"))) static void dma_softirq(void) {
+  uint32_t cpsr = irq_save();
+  uint32_t tc = dma_done_tc;
+  uint32_t err = dma_done_err;
+  dma_done_tc = 0;
+  dma_done_err = 0;
+  irq_restore(cpsr);
+
+  for (uint32_t i = 0; i < DMA_CHANNELS; i++) {
+    uint32_t bit = 1 << i;
+    if (!((tc | err) & bit)) {
+      continue;
+    }
+    _dma_callback_t callback = dma_channels[i].callback;
+    void *arg = dma_channels[i].arg;
+    c_dma_chan_free(i);
+    if (callback) {
+      callback(arg, (err & bit) ? DMA_ERROR_FAULT : DMA_SUCCESS);
+    }
+  }
+}
+
+#else
+// No driver for this board's DMA controller: the asynchronous copies fail
+// and SYS_UART_WRITE polls the buffer out, after the same permission check.
+
+__attribute__((section(".kernel.text"))) void c_dma_init(void) {}
+
+__attribute__((section(".kernel.text"))) int32_t c_dma_chan_alloc(void) {
+  return DMA_ERROR_NODEV;
+}
+
+__attribute__((section(".kernel.text"))) void c_dma_chan_free(uint32_t chan) {
+  (void)chan;
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_memcpy_async(void *dst, const void *src, uint32_t size,
+                   _dma_callback_t callback, void *arg) {
+  (void)dst, (void)src, (void)size, (void)callback, (void)arg;
+  return DMA_ERROR_NODEV;
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_uart_write_async(const void *buf, uint32_t size,
+                       _dma_callback_t callback, void *arg) {
+  (void)buf, (void)size, (void)callback, (void)arg;
+  return DMA_ERROR_NODEV;
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_uart_write_user_async(const void *buf, uint32_t size,
+                            _dma_callback_t callback, void *arg) {
+  (void)buf, (void)size, (void)callback, (void)arg;
+  return DMA_ERROR_NODEV;
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_dma_uart_write(const void *buf, uint32_t size) {
+  const char *s = (const char *)buf;
+  uint32_t pa;
+
+  if (size == 0) {
+    return DMA_ERROR_SIZE;
+  }
+  // Every page of the buffer has to be readable from USR mode
+  for (uintptr_t page = (uintptr_t)buf & ~0xFFF;
+       page < (uintptr_t)buf + size; page += 0x1000) {
+    if (!dma_pa(page, DMA_ATS_USER_READ, &pa)) {
+      return DMA_ERROR_FAULT;
+    }
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    c_putchar(s[i]);
+  }
+  return size;
+}
+#endif
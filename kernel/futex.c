@@ -0,0 +1,55 @@
+#include "inc/futex.h"
+#include "inc/sched.h"
+
+// Translates the address with the current task's tables and user write
+// permissions (ATS1CUW), so a task cannot wait on memory it cannot lock.
+// Returns 0 if the translation faults.
+__attribute__((section(".kernel.text"))) static uintptr_t
+futex_key(volatile uint32_t *addr) {
+  uint32_t par;
+  asm volatile("mcr p15, 0, %1, c7, c8, 3\n\t"
+               "isb\n\t"
+               "mrc p15, 0, %0, c7, c4, 0"
+               : "=r"(par)
+               : "r"(addr));
+  // PAR.F
+  if (par & 0x1) {
+    return 0;
+  }
+  return (par & 0xFFFFF000) | ((uintptr_t)addr & 0xFFF);
+}
+
+// Called from the SWI handler, IRQs are masked until the task returns to USR
+// mode, so the check and the block cannot race with a wake.
+__attribute__((section(".kernel.text"))) int32_t
+c_futex_wait(volatile uint32_t *addr, uint32_t val, uint32_t owner) {
+  if ((uintptr_t)addr & 0x3) {
+    return FUTEX_ERROR_INVAL;
+  }
+  uintptr_t key = futex_key(addr);
+  if (key == 0) {
+    return FUTEX_ERROR_FAULT;
+  }
+  if (*addr != val) {
+    return FUTEX_ERROR_AGAIN;
+  }
+
+  _task_id_t hint = SCHED_NO_HINT;
+  if (owner != 0 && owner <= MAX_TASKS) {
+    hint = owner - 1;
+  }
+  c_task_block(key, hint);
+  return FUTEX_SUCCESS;
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_futex_wake(volatile uint32_t *addr, uint32_t count) {
+  if ((uintptr_t)addr & 0x3) {
+    return FUTEX_ERROR_INVAL;
+  }
+  uintptr_t key = futex_key(addr);
+  if (key == 0) {
+    return FUTEX_ERROR_FAULT;
+  }
+  return c_task_wake(key, count);
+}
@@ -1,4 +1,5 @@
 #include "inc/gic.h"
+#include "inc/sched.h"
 
 __attribute__((section(".kernel.text"))) void c_gic_init() {
   _gicc_t *const GICC0 = (_gicc_t *)GICC0_ADDR;
@@ -9,12 +10,25 @@ __attribute__((section(".kernel.text"))) void c_gic_init() {
   // priority 0xF are masked but interrupts with higher
   // priority values 0x0 to 0xE are not masked
   GICC0->PMR = 0x000000F0;
-  // Enable interrupt 36 (Timer)
-  GICD0->ISENABLER[1] |= 0x00000010;
-  // Enable interrupt 44 (UART0)
-  GICD0->ISENABLER[1] |= 0x00001000;
+  // Systick
+  c_gic_enable(GIC_SOURCE_TICK);
+  // UART0
+  c_gic_enable(GIC_SOURCE_UART0);
+  // Enable the reschedule SGI
+  GICD0->ISENABLER[0] |= 1 << GIC_SGI_RESCHED;
   // Enable the CPU interface for this GIC
   GICC0->CTLR = 0x00000001;
   // Enable the CPU interface for this GIC
   GICD0->CTLR = 0x00000001;
 }
+
+__attribute__((section(".kernel.text"))) void c_gic_enable(uint32_t id) {
+  _gicd_t *const GICD0 = (_gicd_t *)GICD0_ADDR;
+
+  // SPIs reset with no target on the MPCore GIC, the SGIs and PPIs (below
+  // 32) always go to their own CPU. ITARGETSR is byte accessible.
+  if (id >= 32) {
+    ((volatile uint8_t *)GICD0->ITARGETSR)[id] = 0x01;
+  }
+  GICD0->ISENABLER[GIC_ENABLE_REG(id)] |= GIC_ENABLE_BIT(id);
+}
@@ -0,0 +1,44 @@
+#ifndef __ARENA_LIB_H
+#define __ARENA_LIB_H
+
+#include <stdint.h>
+
+// User-space allocator
+// Lives in the shared user library (.ulib.text), mapped into every user task,
+// and keeps its state in an _arena_t owned by the task. Small requests are
+// served from per size-class free lists, refilled ARENA_GROW bytes at a time
+// with SYS_BRK, so most calls never enter the kernel. Requests above the
+// largest class get their own pages from SYS_MMAP, and are reused first-fit
+// once freed.
+// Every block starts with an 8-byte header, keeping the payload 8-byte
+// aligned.
+
+#define ARENA_MIN_SHIFT 4 // 16 bytes
+#define ARENA_CLASSES 8   // Up to 2KB
+#define ARENA_MAX_SMALL (1u << (ARENA_MIN_SHIFT + ARENA_CLASSES - 1))
+#define ARENA_GROW 0x4000
+#define ARENA_HEADER 8
+#define ARENA_LARGE (1u << 31) // Header flag, the rest is the page count
+
+typedef struct _arena_block {
+  uint32_t info; // Size class, or ARENA_LARGE | pages
+  struct _arena_block *next; // Only while free
+} _arena_block_t;
+
+typedef struct {
+  _arena_block_t *free[ARENA_CLASSES];
+  _arena_block_t *large;
+  uint32_t top; // Bump pointer into the brk area
+  uint32_t end; // Current break
+  // Statistics
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t syscalls;
+} _arena_t;
+
+void arena_init(_arena_t *arena);
+// Returns NULL when the task's heap window is exhausted
+void *arena_alloc(_arena_t *arena, uint32_t size);
+void arena_free(_arena_t *arena, void *ptr);
+
+#endif // __ARENA_LIB_H
@@ -0,0 +1,68 @@
+#ifndef __ATOMIC_LIB_H
+#define __ATOMIC_LIB_H
+
+#include <stdint.h>
+
+// Atomic operations on 32-bit words with LDREX/STREX, usable in USR mode.
+// They do not order the surrounding accesses, callers add atomic_barrier()
+// where they need acquire/release semantics.
+// https://developer.arm.com/documentation/dht0008/a/arm-synchronization-primitives/exclusive-accesses/ldrex-and-strex
+
+__attribute__((always_inline)) static inline void atomic_barrier(void) {
+  asm volatile("dmb" ::: "memory");
+}
+
+// Stores `desired` if *ptr == expected. Returns the value *ptr had, so the
+// exchange happened when it equals `expected`.
+__attribute__((always_inline)) static inline uint32_t
+atomic_cas(volatile uint32_t *ptr, uint32_t expected, uint32_t desired) {
+  uint32_t old, failed;
+  asm volatile("1: ldrex %0, [%2]\n\t"
+               "mov %1, #0\n\t"
+               "cmp %0, %3\n\t"
+               "bne 2f\n\t"
+               "strex %1, %4, [%2]\n\t"
+               "cmp %1, #0\n\t"
+               "bne 1b\n\t"
+               "2:"
+               : "=&r"(old), "=&r"(failed)
+               : "r"(ptr), "r"(expected), "r"(desired)
+               : "cc", "memory");
+  return old;
+}
+
+// Stores `val` and returns the previous value
+__attribute__((always_inline)) static inline uint32_t
+atomic_swap(volatile uint32_t *ptr, uint32_t val) {
+  uint32_t old, failed;
+  asm volatile("1: ldrex %0, [%2]\n\t"
+               "strex %1, %3, [%2]\n\t"
+               "cmp %1, #0\n\t"
+               "bne 1b"
+               : "=&r"(old), "=&r"(failed)
+               : "r"(ptr), "r"(val)
+               : "cc", "memory");
+  return old;
+}
+
+// Adds `val` and returns the new value
+__attribute__((always_inline)) static inline uint32_t
+atomic_add(volatile uint32_t *ptr, uint32_t val) {
+  uint32_t res, failed;
+  asm volatile("1: ldrex %0, [%2]\n\t"
+               "add %0, %0, %3\n\t"
+               "strex %1, %0, [%2]\n\t"
+               "cmp %1, #0\n\t"
+               "bne 1b"
+               : "=&r"(res), "=&r"(failed)
+               : "r"(ptr), "r"(val)
+               : "cc", "memory");
+  return res;
+}
+
+__attribute__((always_inline)) static inline uint32_t
+atomic_sub(volatile uint32_t *ptr, uint32_t val) {
+  return atomic_add(ptr, -val);
+}
+
+#endif // __ATOMIC_LIB_H
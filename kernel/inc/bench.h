@@ -0,0 +1,33 @@
+#ifndef __BENCH_LIB_H
+#define __BENCH_LIB_H
+
+#include <stdint.h>
+
+// Micro-benchmarks
+// Built with `make bench` (CONFIG_BENCH). They run once at boot, print one
+// line per benchmark over UART0 and exit QEMU through semihosting:
+//   BENCH <name> <iterations> <cycles>
+// with both numbers in hex and the cycles read from PMCCNTR.
+// tools/bench_compare.py compares the lines against a stored baseline.
+
+#define BENCH_ITERATIONS 64
+// copy_sections and map_region are slower, and print while they run
+#define BENCH_SLOW_ITERATIONS 8
+
+// Unused virtual address range, for map_region
+#define BENCH_MAP_VA 0x7FF00000
+#define BENCH_MAP_SIZE (16 * 0x1000)
+
+// SGI raised for the IRQ round trip
+#define BENCH_SGI 0
+
+// Before the MMU is enabled: copy_sections and map_region
+void c_bench_early(void);
+// After c_scheduler_init(): system call, IRQ and context switch, then exit
+void c_bench_late(void);
+// BENCH_SGI handler
+void c_bench_irq(void);
+
+uint32_t _bench_in_irq_mode(uint32_t (*fn)(uint32_t), uint32_t arg);
+
+#endif // __BENCH_LIB_H
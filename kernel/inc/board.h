@@ -0,0 +1,18 @@
+#ifndef __BOARD_LIB_H
+#define __BOARD_LIB_H
+
+// Board description, picked at build time (`make BOARD=...`, see Makefile)
+// Each board header gives the device addresses and GIC sources, the drivers
+// to build (BOARD_UART_*, BOARD_TIMER_*, BOARD_HAS_DMA) and BOARD_DEVICES,
+// the device pages c_mmu_fill_tables() maps. The RAM layout is in
+// linker/<board>/board.ld.
+//   realview: RealView PB-A8 (Cortex-A8), the default
+//   zynq:     Zynq-7000 (Cortex-A9 MPCore), CONFIG_BOARD_ZYNQ
+
+#ifdef CONFIG_BOARD_ZYNQ
+#include "board_zynq.h"
+#else
+#include "board_realview.h"
+#endif
+
+#endif // __BOARD_LIB_H
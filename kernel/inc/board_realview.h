@@ -0,0 +1,55 @@
+#ifndef __BOARD_REALVIEW_LIB_H
+#define __BOARD_REALVIEW_LIB_H
+
+// RealView Platform Baseboard for Cortex-A8, QEMU `-M realview-pb-a8`
+// RAM at 0x70000000 (linker/realview/board.ld)
+
+#define BOARD_NAME "realview-pb-a8"
+#define BOARD_UART_PL011
+#define BOARD_TIMER_SP804
+#define BOARD_HAS_DMA
+
+#define GICC0_ADDR 0x1E000000
+#define GICD0_ADDR 0x1E001000
+#define GICC1_ADDR 0x1E010000
+#define GICD1_ADDR 0x1E011000
+#define GICC2_ADDR 0x1E020000
+#define GICD2_ADDR 0x1E021000
+#define GICC3_ADDR 0x1E030000
+#define GICD3_ADDR 0x1E031000
+
+#define GIC_SOURCE_TIMER0 36
+#define GIC_SOURCE_TIMER1 37
+#define GIC_SOURCE_TIMER2 73
+#define GIC_SOURCE_TIMER3 74
+
+#define GIC_SOURCE_UART0 44
+#define GIC_SOURCE_UART1 45
+#define GIC_SOURCE_UART2 46
+#define GIC_SOURCE_UART3 47
+
+#define GIC_SOURCE_DMA 56
+
+// SP804 dual timers: TIMER0's Timer1 is the systick, its Timer2 the
+// clocksource (kernel/inc/clock.h)
+#define TIMER0_ADDR 0x10011000
+#define TIMER1_ADDR 0x10012000
+#define TIMER2_ADDR 0x10018000
+#define TIMER3_ADDR 0x10019000
+#define GIC_SOURCE_TICK GIC_SOURCE_TIMER0
+
+// PL011
+#define UART0_ADDR 0x10009000
+// PL081
+#define DMA_ADDR 0x10030000
+
+// X(name, address, L2 flags), TIMER0 is readable by the tasks for
+// clock_now_*()
+#define BOARD_DEVICES(X)                                                       \
+  X("GICC0", GICC0_ADDR, L2_DEFAULT_FLAGS)                                     \
+  X("GICD0", GICD0_ADDR, L2_DEFAULT_FLAGS)                                     \
+  X("UART0", UART0_ADDR, L2_DEFAULT_FLAGS)                                     \
+  X("DMA", DMA_ADDR, L2_DEFAULT_FLAGS)                                         \
+  X("TIMER0", TIMER0_ADDR, L2_KRN_RW_USR_RO_FLAGS)
+
+#endif // __BOARD_REALVIEW_LIB_H
@@ -0,0 +1,42 @@
+#ifndef __BOARD_ZYNQ_LIB_H
+#define __BOARD_ZYNQ_LIB_H
+
+// Zynq-7000, QEMU `-M xilinx-zynq-a9`. Only CPU0 of the MPCore is used.
+// DDR at 0x00000000 (linker/zynq/board.ld)
+
+#define BOARD_NAME "xilinx-zynq-a9"
+#define BOARD_UART_CDNS
+#define BOARD_TIMER_A9
+// The PL330 DMA controller has no driver, SYS_UART_WRITE polls UART0
+
+// Cortex-A9 private region: SCU, GIC CPU interface and the timers share its
+// first page, the GIC distributor has its own
+#define MPCORE_ADDR 0xF8F00000
+#define GICC0_ADDR (MPCORE_ADDR + 0x0100)
+#define GTIMER_ADDR (MPCORE_ADDR + 0x0200)
+#define PTIMER_ADDR (MPCORE_ADDR + 0x0600)
+#define GICD0_ADDR (MPCORE_ADDR + 0x1000)
+
+// Private timer PPI, the systick. The global timer is the clocksource.
+#define GIC_SOURCE_PTIMER 29
+#define GIC_SOURCE_TICK GIC_SOURCE_PTIMER
+// Both timers count at PERIPHCLK / (prescaler + 1). QEMU's PERIPHCLK is
+// 100MHz, which the prescaler brings down to 1MHz; on a real board it is
+// half the CPU clock and the prescaler has to follow.
+#define TIMER_PRESCALER 99
+
+#define GIC_SOURCE_UART0 59
+#define GIC_SOURCE_UART1 82
+
+// Cadence UART
+#define UART0_ADDR 0xE0000000
+#define UART1_ADDR 0xE0001000
+
+// X(name, address, L2 flags). The MPCore page holds the GIC CPU interface,
+// where even a read (IAR) has side effects, so it stays kernel only.
+#define BOARD_DEVICES(X)                                                       \
+  X("MPCORE", MPCORE_ADDR, L2_DEFAULT_FLAGS)                                   \
+  X("GICD0", GICD0_ADDR, L2_DEFAULT_FLAGS)                                     \
+  X("UART0", UART0_ADDR, L2_DEFAULT_FLAGS)
+
+#endif // __BOARD_ZYNQ_LIB_H
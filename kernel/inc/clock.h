@@ -0,0 +1,79 @@
+#ifndef __CLOCK_LIB_H
+#define __CLOCK_LIB_H
+
+#include "syscall.h"
+#include "timer.h"
+#include <stdint.h>
+
+// Clocksource
+// A 1MHz free-running counter, extended to 64 bits by the clock page: base is
+// the 64-bit count at the raw count `last`, refreshed on every systick (far
+// more often than the ~71 minutes the 32-bit count takes to wrap).
+//   realview: TIMER0's second channel (Timer2), counting down from
+//     0xFFFFFFFF. TIMER0 is mapped read-only into every task, next to the
+//     clock page, so clock_now_*() need no system call in user space either.
+//   zynq: the low word of the A9 global timer. It shares its page with the
+//     GIC CPU interface, so user space reads it through SYS_CLOCK_RAW.
+// The kernel updates the page under a sequence counter, readers retry when
+// it changed.
+
+#define CLOCK_HZ 1000000
+// One count is one microsecond
+#define CLOCK_NS_PER_CYCLE 1000
+
+typedef volatile struct {
+  uint32_t seq; // Odd while an update is in progress
+  uint32_t last;
+  uint64_t base;
+} _clock_page_t;
+
+extern _clock_page_t clock_page;
+
+void c_clock_init(void);
+void c_clock_update(void);
+
+#ifdef BOARD_TIMER_SP804
+// Timer2 counts down, the complement counts up
+__attribute__((always_inline)) static inline uint32_t clock_read_raw(void) {
+  _timer_t *const TIMER0 = (_timer_t *)TIMER0_ADDR;
+  return ~TIMER0->Timer2Value;
+}
+#else
+// Only the low word is needed, the clock page extends it
+__attribute__((always_inline)) static inline uint32_t clock_read_raw(void) {
+  _gtimer_t *const GTIMER = (_gtimer_t *)GTIMER_ADDR;
+  uint32_t cpsr;
+
+  asm volatile("mrs %0, cpsr" : "=r"(cpsr));
+  if ((cpsr & 0x1F) == 0x10) {
+    return SYSCALL0(SYS_CLOCK_RAW);
+  }
+  return GTIMER->CounterLo;
+}
+#endif
+
+__attribute__((always_inline)) static inline uint64_t clock_now_cycles(void) {
+  uint32_t seq, last, raw;
+  uint64_t base;
+
+  do {
+    seq = clock_page.seq;
+    asm volatile("dmb" ::: "memory");
+    base = clock_page.base;
+    last = clock_page.last;
+    raw = clock_read_raw();
+    asm volatile("dmb" ::: "memory");
+  } while ((seq & 1) || seq != clock_page.seq);
+
+  return base + (uint32_t)(raw - last);
+}
+
+__attribute__((always_inline)) static inline uint64_t clock_now_us(void) {
+  return clock_now_cycles();
+}
+
+__attribute__((always_inline)) static inline uint64_t clock_now_ns(void) {
+  return clock_now_cycles() * CLOCK_NS_PER_CYCLE;
+}
+
+#endif // __CLOCK_LIB_H
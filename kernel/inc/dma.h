@@ -0,0 +1,111 @@
+#ifndef __DMA_LIB_H
+#define __DMA_LIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+// PrimeCell DMA controller (PL080/PL081)
+// The realview boards have a PL081 (2 channels) on the same register layout
+// as the 8 channel PL080. A transfer is a chain of linked list items (LLIs),
+// one per physically contiguous chunk, and raises GIC_SOURCE_DMA when the
+// last one completes. The caches are off, so no maintenance is needed.
+// Boards without BOARD_HAS_DMA get a polled SYS_UART_WRITE and no
+// asynchronous copies (DMA_ERROR_NODEV).
+
+#define DMA_CHANNELS 2
+#define DMA_MAX_LLI 16
+// TransferSize is 12 bits wide, in units of the source width
+#define DMA_MAX_TRANSFER 0xFFF
+
+// Global Configuration
+#define DMA_CONFIG_E (1 << 0u)
+
+// Channel Control
+#define DMA_CTRL_SIZE(n) ((n) & DMA_MAX_TRANSFER)
+#define DMA_CTRL_SBSIZE(b) ((b) << 12u)
+#define DMA_CTRL_DBSIZE(b) ((b) << 15u)
+#define DMA_CTRL_SWIDTH(w) ((w) << 18u)
+#define DMA_CTRL_DWIDTH(w) ((w) << 21u)
+#define DMA_CTRL_SI (1 << 26u)
+#define DMA_CTRL_DI (1 << 27u)
+#define DMA_CTRL_I (1u << 31u)
+#define DMA_WIDTH_BYTE 0
+#define DMA_WIDTH_WORD 2
+#define DMA_BURST_4 1
+
+// Channel Configuration
+#define DMA_CH_E (1 << 0u)
+#define DMA_CH_FLOW_M2M (0 << 11u)
+#define DMA_CH_IE (1 << 14u)
+#define DMA_CH_ITC (1 << 15u)
+#define DMA_CH_A (1 << 17u)
+
+#define reserved_bits(x, y, z) uint8_t reserved##x[z - y + 1];
+
+typedef volatile struct {
+  uint32_t SrcAddr;
+  uint32_t DestAddr;
+  uint32_t LLI;
+  uint32_t Control;
+  uint32_t Configuration;
+  reserved_bits(0, 0x014, 0x01F);
+} _dma_chan_regs_t;
+
+typedef volatile struct {
+  uint32_t IntStatus;
+  uint32_t IntTCStatus;
+  uint32_t IntTCClear;
+  uint32_t IntErrorStatus;
+  uint32_t IntErrClr;
+  uint32_t RawIntTCStatus;
+  uint32_t RawIntErrorStatus;
+  uint32_t EnbldChns;
+  uint32_t SoftBReq;
+  uint32_t SoftSReq;
+  uint32_t SoftLBReq;
+  uint32_t SoftLSReq;
+  uint32_t Configuration;
+  uint32_t Sync;
+  reserved_bits(0, 0x038, 0x0FF);
+  _dma_chan_regs_t Channel[8];
+} _dma_t;
+
+// Linked list item, read by the controller (word aligned, physical addresses)
+typedef struct {
+  uint32_t src;
+  uint32_t dst;
+  uint32_t next;
+  uint32_t control;
+} _dma_lli_t;
+
+#define DMA_SUCCESS 0
+#define DMA_ERROR_BUSY -1  // No free channel
+#define DMA_ERROR_FAULT -2 // A buffer page is not mapped
+#define DMA_ERROR_SIZE -3  // Zero sized, or needs more than DMA_MAX_LLI items
+#define DMA_ERROR_NODEV -4 // The board has no DMA controller driver
+
+// Runs in the kworker (SOFTIRQ_DMA) once the transfer is done (DMA_SUCCESS)
+// or the controller reported a bus error (DMA_ERROR_FAULT). The channel is
+// already free again.
+typedef void (*_dma_callback_t)(void *arg, int32_t status);
+
+void c_dma_init(void);
+int32_t c_dma_chan_alloc(void);
+void c_dma_chan_free(uint32_t chan);
+// Asynchronous copies, they return the channel used or a DMA_ERROR_*.
+// Buffers are virtual addresses of the current task's tables.
+int32_t c_dma_memcpy_async(void *dst, const void *src, uint32_t size,
+                           _dma_callback_t callback, void *arg);
+int32_t c_dma_uart_write_async(const void *buf, uint32_t size,
+                               _dma_callback_t callback, void *arg);
+// Same, with the buffer checked against the task's user permissions
+int32_t c_dma_uart_write_user_async(const void *buf, uint32_t size,
+                                    _dma_callback_t callback, void *arg);
+// SYS_UART_WRITE: blocks the calling task until the transfer is done. The
+// task gets `size` back, or the DMA_ERROR_* the transfer ended with.
+int32_t c_dma_uart_write(const void *buf, uint32_t size);
+void c_dma_irq(void);
+
+#endif // __DMA_LIB_H
@@ -0,0 +1,23 @@
+#ifndef __FUTEX_LIB_H
+#define __FUTEX_LIB_H
+
+#include <stdint.h>
+
+// Futexes
+// The user-space locks (mutex.h, sem.h) only enter the kernel on contention.
+// A futex is keyed by the physical address of its word, so tasks that map
+// the same memory at different addresses still meet on the same key.
+//   SYS_FUTEX_WAIT(addr, val, owner): blocks the task if *addr == val.
+//     owner is the lock holder's task id + 1 (0 if unknown), it runs next.
+//   SYS_FUTEX_WAKE(addr, count): readies up to count tasks waiting on addr,
+//     returns how many were woken.
+
+#define FUTEX_SUCCESS 0
+#define FUTEX_ERROR_AGAIN -1 // *addr != val, try again
+#define FUTEX_ERROR_FAULT -2 // addr not writable by the task
+#define FUTEX_ERROR_INVAL -3 // addr not word aligned
+
+int32_t c_futex_wait(volatile uint32_t *addr, uint32_t val, uint32_t owner);
+int32_t c_futex_wake(volatile uint32_t *addr, uint32_t count);
+
+#endif // __FUTEX_LIB_H
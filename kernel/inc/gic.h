@@ -4,24 +4,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define GICC0_ADDR 0x1E000000
-#define GICD0_ADDR 0x1E001000
-#define GICC1_ADDR 0x1E010000
-#define GICD1_ADDR 0x1E011000
-#define GICC2_ADDR 0x1E020000
-#define GICD2_ADDR 0x1E021000
-#define GICC3_ADDR 0x1E030000
-#define GICD3_ADDR 0x1E031000
+#include "board.h"
 
-#define GIC_SOURCE_TIMER0 36
-#define GIC_SOURCE_TIMER1 37
-#define GIC_SOURCE_TIMER2 73
-#define GIC_SOURCE_TIMER3 74
-
-#define GIC_SOURCE_UART0 44
-#define GIC_SOURCE_UART1 45
-#define GIC_SOURCE_UART2 46
-#define GIC_SOURCE_UART3 47
+// Register and bit of a GIC source in the ISENABLER/ICENABLER style banks
+#define GIC_ENABLE_REG(id) ((id) >> 5)
+#define GIC_ENABLE_BIT(id) (1u << ((id) & 31))
 
 #define reserved_bits(x, y, z) uint8_t reserved##x[z - y + 1];
 
@@ -35,6 +22,9 @@ typedef volatile struct {
   uint32_t HPPIR;
 } _gicc_t;
 
+// SGIR TargetListFilter: only to the CPU that writes the register
+#define GICD_SGIR_TARGET_SELF (0b10 << 24)
+
 typedef volatile struct {
   uint32_t CTLR;
   uint32_t TYPER;
@@ -60,5 +50,7 @@ typedef volatile struct {
 } _gicd_t;
 
 void c_gic_init();
+// Routes an interrupt to this CPU and enables it
+void c_gic_enable(uint32_t id);
 
 #endif // __GIC_LIB_H
@@ -0,0 +1,20 @@
+#ifndef __IRQ_LIB_H
+#define __IRQ_LIB_H
+
+#include <stdint.h>
+
+// Masks IRQs and returns the previous CPSR, to be passed to irq_restore().
+// Used around data shared between the IRQ handlers and task context.
+__attribute__((always_inline)) static inline uint32_t irq_save(void) {
+  uint32_t cpsr;
+  asm volatile("mrs %0, cpsr\n\t"
+               "cpsid i"
+               : "=r"(cpsr)::"memory");
+  return cpsr;
+}
+
+__attribute__((always_inline)) static inline void irq_restore(uint32_t cpsr) {
+  asm volatile("msr cpsr_c, %0" ::"r"(cpsr) : "memory");
+}
+
+#endif // __IRQ_LIB_H
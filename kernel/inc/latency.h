@@ -0,0 +1,41 @@
+#ifndef __LATENCY_LIB_H
+#define __LATENCY_LIB_H
+
+#include <stdint.h>
+
+// Timer IRQ latency
+// Built with `make build LATENCY=1` (CONFIG_LATENCY). The systick timer
+// raises its IRQ when it reloads, so timer_tick_elapsed() is the number of
+// counts (microseconds) since the IRQ fired. It is sampled twice per timer
+// IRQ:
+//   entry:  right after reading IAR
+//   resume: when c_irq_handler() returns into the chosen task
+// Each goes into a log-linear histogram: LAT_SUB_BUCKETS buckets per power of
+// two, so the error of a percentile is below 1/LAT_SUB_BUCKETS.
+
+#define LAT_SUB_BITS 3
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+// Enough for the 0x10000-count systick period
+#define LAT_BUCKETS 128
+// The idle task reports every LAT_REPORT_TICKS ticks
+#define LAT_REPORT_TICKS 1000u
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[LAT_BUCKETS];
+} _lat_hist_t;
+
+#ifdef CONFIG_LATENCY
+void c_lat_irq_entry(void);
+void c_lat_irq_resume(void);
+#else
+static inline void c_lat_irq_entry(void) {}
+static inline void c_lat_irq_resume(void) {}
+#endif
+// Prints min/avg/p99/max of both histograms, and clears them if reset != 0
+void c_lat_report(uint32_t reset);
+
+#endif // __LATENCY_LIB_H
@@ -0,0 +1,89 @@
+#ifndef __LOADER_LIB_H
+#define __LOADER_LIB_H
+
+#include "mmu.h"
+#include "sched.h"
+#include <stdint.h>
+
+// Task images
+// Every task is described by a _task_image_t placed in the .task_images.<slot>
+// section. The linker sorts and collects them between __task_images_start and
+// __task_images_end, and c_scheduler_init() loads one task per image. Adding a
+// task means adding its sections to the linker script and a TASK_IMAGE() entry
+// next to its code, nothing else, as long as the images fit in MAX_TASKS.
+
+#define TASK_IMAGE_MAGIC 0x4B534154 // "TASK"
+#define TASK_MAX_SEGMENTS 8
+
+// Segment permissions
+#define SEG_WRITE (1 << 0u)
+#define SEG_EXEC (1 << 1u)
+#define SEG_USER (1 << 2u)
+// Segment initialization
+// Without SEG_LOAD or SEG_ZERO the segment is only mapped, its contents are
+// left as they are (e.g. the RAREA windows).
+#define SEG_LOAD (1 << 3u) // Copy size bytes from lma into phy
+#define SEG_ZERO (1 << 4u) // Clear size bytes at phy
+
+typedef struct {
+  uintptr_t vma;
+  uintptr_t phy;
+  uintptr_t lma; // Only used by SEG_LOAD segments
+  uintptr_t size;
+  uint32_t flags;
+} _task_segment_t;
+
+typedef struct _task_image {
+  uint32_t magic;
+  _task_ptr_t entrypoint;
+  _systick_t ticks;
+  uint32_t flags; // TASK_KERNEL
+  // The top TASK_IRQ_STACK_SIZE bytes of the stack hold the task's IRQ frame,
+  // the rest is the stack the task itself runs on.
+  _task_segment_t stack;
+  uint32_t segment_count;
+  _task_segment_t segments[TASK_MAX_SEGMENTS];
+} _task_image_t;
+
+// Declares the linker symbols of a `_<TASK>_<SEG>_*` section
+#define DECLARE_TASK_SEGMENT(task, seg)                                        \
+  extern uint32_t _##task##_##seg##_LMA, _##task##_##seg##_VMA,                \
+      _##task##_##seg##_PHY;                                                   \
+  extern uint8_t _##task##_##seg##_SIZE
+
+#define TASK_SEGMENT(vma, phy, lma, size, flags)                               \
+  {(uintptr_t)&vma, (uintptr_t)&phy, (lma), (uintptr_t)&size, (flags)}
+#define TASK_LOAD_SEGMENT(task, seg, flags)                                    \
+  TASK_SEGMENT(_##task##_##seg##_VMA, _##task##_##seg##_PHY,                   \
+               (uintptr_t)&_##task##_##seg##_LMA, _##task##_##seg##_SIZE,      \
+               (flags) | SEG_LOAD)
+#define TASK_ZERO_SEGMENT(task, seg, flags)                                    \
+  TASK_SEGMENT(_##task##_##seg##_VMA, _##task##_##seg##_PHY, 0,                \
+               _##task##_##seg##_SIZE, (flags) | SEG_ZERO)
+#define TASK_STACK_SEGMENT(vma, phy, size)                                     \
+  TASK_SEGMENT(vma, phy, 0, size, SEG_WRITE)
+
+// TASK_IMAGE(slot, entrypoint, ticks, flags, stack, segments...)
+// The slot sets the load order, slot 0 has to be the idle task. Slots past
+// MAX_TASKS do not build.
+#define TASK_IMAGE(slot, entry, slice, task_flags, stack_segment, ...)         \
+  _Static_assert((slot) < MAX_TASKS, "TASK_IMAGE slot past MAX_TASKS");       \
+  __attribute__((section(".task_images." #slot), used))                       \
+  const _task_image_t task_image_##slot = {                                    \
+      .magic = TASK_IMAGE_MAGIC,                                               \
+      .entrypoint = entry,                                                     \
+      .ticks = slice,                                                          \
+      .flags = task_flags,                                                     \
+      .stack = stack_segment,                                                  \
+      .segment_count =                                                         \
+          sizeof((_task_segment_t[]){__VA_ARGS__}) / sizeof(_task_segment_t),  \
+      .segments = {__VA_ARGS__},                                               \
+  }
+
+extern const _task_image_t __task_images_start[];
+extern const _task_image_t __task_images_end[];
+
+int32_t c_loader_load(const _task_image_t *image, mmu_tables_t *tables);
+uint32_t c_loader_l2_flags(uint32_t seg_flags);
+
+#endif // __LOADER_LIB_H
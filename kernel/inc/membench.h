@@ -0,0 +1,83 @@
+#ifndef __MEMBENCH_LIB_H
+#define __MEMBENCH_LIB_H
+
+#include <stdint.h>
+
+// Memory bandwidth and latency benchmarks
+// Run by the user tasks from the shared user library (.ulib.text), on
+// buffers of each configured size: the task's RAREA when it is large
+// enough, pages from SYS_BRK otherwise.
+//   copy, scale, add, triad: STREAM kernels on 32-bit words, in word
+//     (ldr/str), ldm (LDM/STM) and neon (VLD1/VST1) variants
+//   chase: load latency, following a random cycle of pointers one
+//     MEMBENCH_STRIDE apart
+//   pattern: fills the buffer with each of four patterns (one variant per
+//     access width) and verifies it word by word
+// Every measurement keeps the fastest of MEMBENCH_RUNS runs, which filters
+// out the runs the task was preempted in. Each result is one line over
+// UART0 (SYS_UART_WRITE), numbers in hex:
+//   MEMBENCH <task> <test> <variant> <size> <MB/s> <ns/access> <errors>
+
+#define MEMBENCH_RUNS 8
+// A timed run repeats the kernel until it moved at least this many bytes
+#define MEMBENCH_MIN_BYTES 0x40000
+// and the chase until it did this many loads, so the 1us clock resolves it
+#define MEMBENCH_MIN_LOADS 0x4000
+// Chase elements are one L2 cache line apart
+#define MEMBENCH_STRIDE 64
+// STREAM scalar, has to match MB_Q (core/membench.s)
+#define MEMBENCH_Q 3
+// Sizes are per array. STREAM uses three, and SYS_BRK has the task's 1MB
+// heap window.
+#define MEMBENCH_MIN_SIZE 0x1000
+#define MEMBENCH_MAX_SIZE 0x40000
+
+enum {
+  MEMBENCH_WORD,
+  MEMBENCH_LDM,
+  MEMBENCH_NEON,
+  MEMBENCH_VARIANTS,
+};
+
+typedef struct {
+  const char *name; // Task name, in the task's own .rodata
+  uint32_t *rarea;
+  uint32_t rarea_size;
+  const uint32_t *sizes; // Powers of two, MEMBENCH_MIN_SIZE to MAX_SIZE
+  uint32_t size_count;
+} _membench_cfg_t;
+
+// core/membench.s
+void _mb_copy_word(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                   uint32_t bytes);
+void _mb_copy_ldm(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                  uint32_t bytes);
+void _mb_copy_neon(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                   uint32_t bytes);
+void _mb_scale_word(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                    uint32_t bytes);
+void _mb_scale_ldm(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                   uint32_t bytes);
+void _mb_scale_neon(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                    uint32_t bytes);
+void _mb_add_word(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                  uint32_t bytes);
+void _mb_add_ldm(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                 uint32_t bytes);
+void _mb_add_neon(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                  uint32_t bytes);
+void _mb_triad_word(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                    uint32_t bytes);
+void _mb_triad_ldm(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                   uint32_t bytes);
+void _mb_triad_neon(uint32_t *dst, const uint32_t *a, const uint32_t *b,
+                    uint32_t bytes);
+void _mb_fill_word(uint32_t *dst, uint32_t pattern, uint32_t bytes);
+void _mb_fill_ldm(uint32_t *dst, uint32_t pattern, uint32_t bytes);
+void _mb_fill_neon(uint32_t *dst, uint32_t pattern, uint32_t bytes);
+uint32_t *_mb_chase(uint32_t *first, uint32_t count);
+
+// Runs every benchmark on every size and reports them
+void membench_run(const _membench_cfg_t *cfg);
+
+#endif // __MEMBENCH_LIB_H
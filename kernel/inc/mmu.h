@@ -12,7 +12,8 @@
 
 // Matches the length defined in the mmap.ld.
 // Should be calculated instead of being hardcoded.
-#define L2_TABLES_PER_TASK 8 // L2 tables per task
+// mmu_tables_t is padded to 32KB by the L1 alignment, so up to 15 fit.
+#define L2_TABLES_PER_TASK 12 // L2 tables per task
 
 typedef struct {
   uint32_t l1_table[L1_ENTRIES] __attribute__((aligned(L1_SIZE)));
@@ -30,6 +31,8 @@ typedef struct {
 // Access Flags:
 // https://developer.arm.com/documentation/ddi0406/b/System-Level-Architecture/Virtual-Memory-System-Architecture--VMSA-/Memory-access-control/Access-permissions?lang=en
 #define L2_SMALL_PAGE_BASE 0b10
+// Execute Never, bit 0 of a small page descriptor
+#define L2_XN 0b01
 // Shifts value to bit 9 for AP[2] (Access Permission bit 2)
 #define AP2(value) (value << 9)
 // Shifts value to bit 5 for AP[1] (Access Permission bit 1)
@@ -42,24 +45,70 @@ typedef struct {
 #define USR_RW AP2(0) | AP1(1) | AP0
 #define KRN_RO AP2(1) | AP1(0) | AP0
 #define USR_RO AP2(1) | AP1(1) | AP0
+// Privileged read/write, user read-only
+#define KRN_RW_USR_RO AP2(0) | AP1(1)
 
 #define L2_USR_FLAGS L2_SMALL_PAGE_BASE | USR_RW // 0x32
 #define L2_USR_ROFLAGS L2_SMALL_PAGE_BASE | USR_RO
 #define L2_KRN_FLAGS L2_SMALL_PAGE_BASE | KRN_RW // 0x12
 #define L2_KRN_ROFLAGS L2_SMALL_PAGE_BASE | KRN_RO
 #define L2_DEFAULT_FLAGS L2_KRN_FLAGS
+#define L2_KRN_RW_USR_RO_FLAGS L2_SMALL_PAGE_BASE | KRN_RW_USR_RO | L2_XN
+#define L2_AP_MASK (AP2(1) | AP1(1) | AP0)
 
 #define ERROR_L1_INDEX_OOR -1
 #define ERROR_L2_INDEX_OOR -2
 #define ERROR_L2_IN_USE -3
 #define PAGING_SUCCESS 0
 
-void c_mmu_fill_tables(mmu_tables_t *tables, uint32_t task_id);
+// Batched updates (c_mmu_map_batch, c_mmu_unmap_range, c_mmu_protect_range)
+// write all the descriptors first, without logging, then issue one barrier
+// and one TLB maintenance pass. Up to MMU_TLB_RANGE_PAGES pages are
+// invalidated by MVA, larger ranges flush the whole TLB. Tables that are not
+// the active ones need no TLB maintenance, the task switch flushes it.
+#define MMU_TLB_RANGE_PAGES 32
+
+typedef struct {
+  uint32_t va;
+  uint32_t pa;
+  uint32_t size; // Bytes, rounded up to whole pages
+  uint32_t flags;
+} _mmu_map_t;
+
+__attribute__((always_inline)) static inline void mmu_tlb_flush_all(void) {
+  // TLBIALL
+  asm volatile("mcr p15, 0, %0, c8, c7, 0\n\t"
+               "dsb\n\t"
+               "isb" ::"r"(0)
+               : "memory");
+}
+
+// Switches to another task's tables. No ASIDs are used, so the TLB entries
+// of the previous task have to go.
+__attribute__((always_inline)) static inline void
+mmu_switch_tables(uint32_t *ttbr0) {
+  asm volatile("mcr p15, 0, %0, c2, c0, 0\n\t"
+               "isb" ::"r"(ttbr0)
+               : "memory");
+  mmu_tlb_flush_all();
+}
+
+void c_mmu_fill_tables(mmu_tables_t *tables);
 void c_mmu_init(void);
 int32_t c_mmu_map_4kb_page(mmu_tables_t *tables, uint32_t virt_addr,
                            uint32_t phys_addr, uint32_t l2_flags);
 int32_t map_region(mmu_tables_t *tables, uint32_t virt_addr, uint32_t phys_addr,
                    uint32_t size_in_bytes, uint32_t l2_flags);
+// The L2 descriptor of virt_addr, NULL if its 1MB has no L2 table
+uint32_t *c_mmu_l2_entry(mmu_tables_t *tables, uint32_t virt_addr);
+int32_t c_mmu_map_batch(mmu_tables_t *tables, const _mmu_map_t *maps,
+                        uint32_t count);
+// release, if not NULL, gets the physical address of every page unmapped
+int32_t c_mmu_unmap_range(mmu_tables_t *tables, uint32_t virt_addr,
+                          uint32_t size_in_bytes, void (*release)(uint32_t));
+int32_t c_mmu_protect_range(mmu_tables_t *tables, uint32_t virt_addr,
+                            uint32_t size_in_bytes, uint32_t l2_flags);
+void clear_memory(void *addr, uint32_t size_in_bytes);
 void copy_lma_into_phy(void *phy, const void *lma, uint32_t size);
 void copy_sections(void);
 
@@ -71,33 +120,14 @@ extern uint32_t _KERNEL_DATA_LMA, _KERNEL_DATA_VMA, _KERNEL_DATA_PHY;
 extern uint32_t _KERNEL_RODATA_LMA, _KERNEL_RODATA_VMA, _KERNEL_RODATA_PHY;
 extern uint32_t _KERNEL_BSS_VMA, _KERNEL_BSS_PHY;
 extern uint32_t _KERNEL_STACK;
-
-// TASK0 sections
-extern uint32_t _TASK0_TEXT_LMA, _TASK0_TEXT_VMA, _TASK0_TEXT_PHY;
-
-// TASK1 sections
-extern uint32_t _TASK1_TEXT_LMA, _TASK1_TEXT_VMA, _TASK1_TEXT_PHY;
-extern uint32_t _TASK1_DATA_LMA, _TASK1_DATA_VMA, _TASK1_DATA_PHY;
-extern uint32_t _TASK1_RODATA_LMA, _TASK1_RODATA_VMA, _TASK1_RODATA_PHY;
-extern uint32_t _TASK1_BSS_VMA, _TASK1_BSS_PHY;
-extern uint32_t _TASK1_STACK, _TASK1_STACK_PHY;
-extern uint32_t _TASK1_RAREA_START_VMA, _TASK1_RAREA_END_VMA,
-    _TASK1_RAREA_START_PHY;
-#define TASK1_RAREA_SIZE_B                                                     \
-  ((uint32_t)(GET_SYMBOL_VALUE(_TASK1_RAREA_END_VMA) -                         \
-              GET_SYMBOL_VALUE(_TASK1_RAREA_START_VMA) + 1))
-
-// TASK2 sections
-extern uint32_t _TASK2_TEXT_LMA, _TASK2_TEXT_VMA, _TASK2_TEXT_PHY;
-extern uint32_t _TASK2_DATA_LMA, _TASK2_DATA_VMA, _TASK2_DATA_PHY;
-extern uint32_t _TASK2_RODATA_LMA, _TASK2_RODATA_VMA, _TASK2_RODATA_PHY;
-extern uint32_t _TASK2_BSS_VMA, _TASK2_BSS_PHY;
-extern uint32_t _TASK2_STACK, _TASK2_STACK_PHY;
-extern uint32_t _TASK2_RAREA_START_VMA, _TASK2_RAREA_END_VMA,
-    _TASK2_RAREA_START_PHY;
-#define TASK2_RAREA_SIZE_B                                                     \
-  ((uint32_t)(GET_SYMBOL_VALUE(_TASK2_RAREA_END_VMA) -                         \
-              GET_SYMBOL_VALUE(_TASK2_RAREA_START_VMA) + 1))
+// Boot region: .text, .data and .bss, loaded and run at _PUBLIC_RAM_INIT
+extern uint32_t _PUBLIC_RAM_INIT;
+// Kernel heap, handed out by the page allocator
+extern uint32_t _KERNEL_HEAP_START;
+// Physical pages for the tasks' heaps, not mapped by c_mmu_fill_tables()
+extern uint32_t _USER_POOL_START;
+// Every task's translation tables (.tables)
+extern uint32_t _MMU_INIT;
 
 // Declare SIZE to get their value from the address with the GET_SYMBOL_VALUE
 // macro
@@ -106,16 +136,8 @@ extern uint8_t _KERNEL_DATA_SIZE;
 extern uint8_t _KERNEL_RODATA_SIZE;
 extern uint8_t _KERNEL_BSS_SIZE;
 extern uint8_t _KERNEL_STACK_SIZE;
-extern uint8_t _TASK0_TEXT_SIZE;
-extern uint8_t _TASK1_TEXT_SIZE;
-extern uint8_t _TASK1_DATA_SIZE;
-extern uint8_t _TASK1_RODATA_SIZE;
-extern uint8_t _TASK1_BSS_SIZE;
-extern uint8_t _TASK1_STACK_SIZE;
-extern uint8_t _TASK2_TEXT_SIZE;
-extern uint8_t _TASK2_DATA_SIZE;
-extern uint8_t _TASK2_RODATA_SIZE;
-extern uint8_t _TASK2_BSS_SIZE;
-extern uint8_t _TASK2_STACK_SIZE;
+extern uint8_t _BOOT_SIZE;
+extern uint8_t _KERNEL_HEAP_SIZE;
+extern uint8_t _USER_POOL_SIZE;
 
 #endif // __MMU_LIB_H__
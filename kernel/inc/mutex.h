@@ -0,0 +1,60 @@
+#ifndef __MUTEX_LIB_H
+#define __MUTEX_LIB_H
+
+#include "atomic.h"
+#include "sched.h"
+#include "syscall.h"
+#include <stdint.h>
+
+// User-space mutex
+// The word is 0 when unlocked, otherwise the owner's task id + 1, with
+// MUTEX_WAITERS set once a task sleeps on it. Uncontended lock and unlock are
+// a single LDREX/STREX sequence, the kernel is only entered to sleep
+// (SYS_FUTEX_WAIT) and to wake a sleeper (SYS_FUTEX_WAKE). Waiters pass the
+// owner to the kernel, which runs it next so it can release the lock.
+
+#define MUTEX_WAITERS (1u << 31)
+#define MUTEX_INIT {0}
+
+typedef struct {
+  volatile uint32_t word;
+} _mutex_t;
+
+__attribute__((always_inline)) static inline void mutex_lock(_mutex_t *m) {
+  uint32_t self = task_self() + 1;
+  uint32_t cur = atomic_cas(&m->word, 0, self);
+
+  while (cur != 0) {
+    // Let the owner know it has to wake someone on unlock
+    if ((cur & MUTEX_WAITERS) == 0 &&
+        atomic_cas(&m->word, cur, cur | MUTEX_WAITERS) != cur) {
+      // The word changed under us, maybe to unlocked: only a CAS from 0
+      // takes the lock
+      cur = atomic_cas(&m->word, 0, self);
+      continue;
+    }
+    SYSCALL3(SYS_FUTEX_WAIT, &m->word, cur | MUTEX_WAITERS,
+             cur & ~MUTEX_WAITERS);
+    // Other tasks may still sleep on it, so keep the flag
+    cur = atomic_cas(&m->word, 0, self | MUTEX_WAITERS);
+  }
+  atomic_barrier();
+}
+
+__attribute__((always_inline)) static inline uint32_t
+mutex_trylock(_mutex_t *m) {
+  if (atomic_cas(&m->word, 0, task_self() + 1) != 0) {
+    return 0;
+  }
+  atomic_barrier();
+  return 1;
+}
+
+__attribute__((always_inline)) static inline void mutex_unlock(_mutex_t *m) {
+  atomic_barrier();
+  if (atomic_swap(&m->word, 0) & MUTEX_WAITERS) {
+    SYSCALL2(SYS_FUTEX_WAKE, &m->word, 1);
+  }
+}
+
+#endif // __MUTEX_LIB_H
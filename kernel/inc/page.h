@@ -0,0 +1,71 @@
+#ifndef __PAGE_LIB_H
+#define __PAGE_LIB_H
+
+#include <stdint.h>
+
+// Page allocator
+// Hands out 4KB pages from two zones, each tracked with one bit per page:
+//   kernel: the kernel heap (_KERNEL_HEAP_START, see linker/mmap.ld),
+//           identity mapped into every task's tables, kernel-only.
+//   user:   the user pool (_USER_POOL_START), not mapped anywhere until
+//           pages are handed to a task (kernel/vm.c).
+
+#define PAGE_SIZE 0x1000
+#define PAGE_SHIFT 12
+#define PAGE_ZONE_MAX_PAGES 1024 // 4MB
+
+// Pre-zeroed pages
+// The idle task keeps up to PAGE_ZERO_POOL pages of the user zone cleared
+// ahead of time (c_page_zero_refill()), one page at a time with IRQs
+// enabled, through a kernel-only window at PAGE_ZERO_VA in its own tables.
+// c_page_zero_get() hands them out in O(1), in the order they were cleared,
+// so consecutive gets usually return contiguous pages. Pool pages count as
+// used in the zone until they are handed back with c_page_zone_free().
+#define PAGE_ZERO_POOL 32
+// Unused virtual address, next to BENCH_MAP_VA
+#define PAGE_ZERO_VA 0x7FE00000
+
+typedef struct {
+  const char *name;
+  uintptr_t base;
+  uint32_t total;
+  uint32_t used;
+  uint32_t failures;
+  uint32_t bitmap[PAGE_ZONE_MAX_PAGES / 32];
+  // Mappings of each used page, above 1 only for pages shared copy-on-write
+  uint8_t refs[PAGE_ZONE_MAX_PAGES];
+} _page_zone_t;
+
+typedef struct {
+  uint32_t pages[PAGE_ZERO_POOL]; // Ring, `count` pages from `head`
+  uint32_t head;
+  uint32_t count;
+  uint32_t hits;   // c_page_zero_get() calls served from the pool
+  uint32_t misses; // and the ones that found it empty
+} _page_zero_pool_t;
+
+extern _page_zone_t page_zone_kernel;
+extern _page_zone_t page_zone_user;
+extern _page_zero_pool_t page_zero_pool;
+
+void c_page_init(void);
+// Returns `count` contiguous pages, or NULL
+void *c_page_zone_alloc(_page_zone_t *zone, uint32_t count);
+void c_page_zone_free(_page_zone_t *zone, void *addr, uint32_t count);
+// Reference counts of single pages. Addresses outside the zone are ignored
+// (and have no count, c_page_refs() returns 0 for them).
+void c_page_ref(_page_zone_t *zone, uint32_t addr);
+void c_page_unref(_page_zone_t *zone, uint32_t addr); // Frees at 0
+uint32_t c_page_refs(_page_zone_t *zone, uint32_t addr);
+// Kernel zone
+void *c_page_alloc(uint32_t count);
+void c_page_free(void *addr, uint32_t count);
+// A zeroed user zone page, or 0 when the pool is empty
+uint32_t c_page_zero_get(void);
+// Free user zone pages, the ones waiting in the zero pool included
+uint32_t c_page_user_available(void);
+// Called by the idle task with IRQs enabled: clears pages until the pool is
+// full or the user zone has none left
+void c_page_zero_refill(void);
+
+#endif // __PAGE_LIB_H
@@ -0,0 +1,24 @@
+#ifndef __PMU_LIB_H
+#define __PMU_LIB_H
+
+#include <stdint.h>
+
+// Performance Monitors cycle counter (PMCCNTR)
+// https://developer.arm.com/documentation/ddi0406/c/System-Level-Architecture/System-Control-Registers-in-a-VMSA-implementation/VMSA-System-control-registers-descriptions--in-register-order/PMCR--Performance-Monitors-Control-Register--VMSA
+
+#define PMCR_E (1 << 0u) // Enable all counters
+#define PMCR_C (1 << 2u) // Reset the cycle counter
+#define PMCNTEN_C (1u << 31) // Cycle counter enable
+
+__attribute__((always_inline)) static inline void pmu_init(void) {
+  asm volatile("mcr p15, 0, %0, c9, c12, 0" ::"r"(PMCR_E | PMCR_C));
+  asm volatile("mcr p15, 0, %0, c9, c12, 1" ::"r"(PMCNTEN_C));
+}
+
+__attribute__((always_inline)) static inline uint32_t pmu_cycles(void) {
+  uint32_t cycles;
+  asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles)::"memory");
+  return cycles;
+}
+
+#endif // __PMU_LIB_H
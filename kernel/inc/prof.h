@@ -0,0 +1,45 @@
+#ifndef __PROF_LIB_H
+#define __PROF_LIB_H
+
+#include "loader.h"
+#include "sched.h"
+#include <stdint.h>
+
+// Statistical PC-sampling profiler
+// Built with `make build PROF=1` (CONFIG_PROF). Every timer tick records the
+// interrupted PC in a histogram of the current task's text segment, split in
+// PROF_BUCKETS buckets of (1 << shift) bytes.
+
+#define PROF_BUCKETS 64
+#define PROF_MIN_SHIFT 2 // One ARM instruction
+// The idle task dumps the histograms every PROF_DUMP_TICKS ticks
+#define PROF_DUMP_TICKS 1000u
+
+// Dump format, all fields are little endian uint32_t:
+//   header:   PROF_MAGIC, PROF_VERSION, task count, PROF_BUCKETS
+//   per task: id, base, shift, samples, other samples, buckets[PROF_BUCKETS]
+// "other" counts the samples outside the text segment (e.g. kernel code).
+#define PROF_MAGIC 0x464F5250 // "PROF"
+#define PROF_VERSION 1
+// With SEMIHOST=1 the dump goes to this host file instead of UART0
+#define PROF_HOST_FILE "prof.bin"
+
+typedef struct {
+  uint32_t base;
+  uint32_t shift;
+  uint32_t samples;
+  uint32_t other;
+  uint32_t buckets[PROF_BUCKETS];
+} _prof_hist_t;
+
+#ifdef CONFIG_PROF
+void c_prof_task_init(_task_id_t id, const _task_image_t *image);
+void c_prof_sample(_task_id_t id, uint32_t pc);
+#else
+static inline void c_prof_task_init(_task_id_t id,
+                                    const _task_image_t *image) {}
+static inline void c_prof_sample(_task_id_t id, uint32_t pc) {}
+#endif
+void c_prof_dump(void);
+
+#endif // __PROF_LIB_H
@@ -0,0 +1,27 @@
+#ifndef __RS_LIB_H
+#define __RS_LIB_H
+
+#include <stdint.h>
+
+// Rust drivers (kernel/rs), linked in with RS=1 (CONFIG_RS)
+// The async executor of kernel/rs/executor.rs polls its futures from
+// rs_executor_run(), which sleeps in wfi until an interrupt wakes one of
+// them. c_irq_handler() hands GIC_SOURCE_UART0 to rs_uart_irq().
+
+void rs_gic_init(void);
+void rs_UART0_init(void);
+void rs_putchar(uint8_t c);
+void rs_puts(const char *s);
+void rs_puts_hex(uint32_t r);
+
+// Wakes the futures waiting on the GIC source `id`
+void rs_irq_wake(uint32_t id);
+// Runs the spawned futures until all of them are done, with IRQs enabled
+void rs_executor_run(void);
+// GIC_SOURCE_UART0 handler for the async UART futures
+void rs_uart_irq(void);
+// Writes `buf` `iterations` times through the executor, returns the bytes
+// written
+uint32_t rs_uart_bench(const char *buf, uint32_t size, uint32_t iterations);
+
+#endif // __RS_LIB_H
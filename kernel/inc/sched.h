@@ -15,22 +15,86 @@ typedef struct {
 typedef void (*_task_ptr_t)(void);
 typedef uint8_t _task_id_t;
 
+typedef enum {
+  TASK_READY,
+  TASK_BLOCKED, // Waiting on a futex, skipped by the scheduler
+  TASK_STOPPED, // Faulted (stack.h), never runs again
+} _task_state_t;
+
+struct _task_image;
 typedef struct {
   uint32_t *sp;
   uint32_t *irq_sp;
+  // Kernel tasks: SVC mode's banked lr and spsr while switched out, the SWIs
+  // of the other tasks overwrite them
+  uint32_t svc_lr;
+  uint32_t svc_spsr;
   uint32_t *ttbr0;
   _task_id_t id;
+  uint32_t flags;
+  _task_state_t state;
+  uintptr_t wait_key; // Futex the task is blocked on
+  const struct _task_image *image; // Shared by the task's clones
+  // Stack segment, the IRQ frame takes its top TASK_IRQ_STACK_SIZE bytes
+  uint32_t stack_base;
+  uint32_t stack_phy;
+  uint32_t stack_size;
+  // Heap window (vm.h): [TASK_HEAP_VMA, heap_brk) is the heap, mapped up to
+  // heap_mapped, and [mmap_base, TASK_HEAP_VMA + TASK_HEAP_SIZE) is mmap'd.
+  uint32_t heap_brk;
+  uint32_t heap_mapped;
+  uint32_t mmap_base;
   _task_ptr_t entrypoint;
   _systick_t task_ticks;
   _systick_t current_ticks;
 } _task_t;
 
-#define MAX_TASKS 3u
+// The four task images plus room for their clones (c_task_clone()). Slots
+// are never reused, a stopped task keeps its own. Each one has an
+// mmu_tables_t in the MMU region (linker/mmap.ld), which has to end below
+// the kernel heap.
+#define MAX_TASKS 12u
+
+// Task flags
+// Kernel tasks run in SVC mode on a stack inside the kernel stack region,
+// the rest run in USR mode.
+#define TASK_KERNEL (1 << 0u)
+
+#define TASK_CLONE_FAILED -1
+
+// Size of the IRQ stack carved from the top of each task's stack.
+#define TASK_IRQ_STACK_SIZE 0x400
+
+// No task to run next, the scheduler goes round-robin
+#define SCHED_NO_HINT 0xFF
+// SGI raised to reschedule outside of the timer tick
+#define GIC_SGI_RESCHED 1
+
+// The scheduler keeps the running task's id in TPIDRURO, which USR mode can
+// read.
+__attribute__((always_inline)) static inline _task_id_t task_self(void) {
+  uint32_t id;
+  asm volatile("mrc p15, 0, %0, c13, c0, 3" : "=r"(id));
+  return (_task_id_t)id;
+}
 
 // Function Definitions
-void c_task_init(_task_ptr_t entrypoint, _systick_t ticks);
+void c_task_init(const struct _task_image *image);
 void c_scheduler_init(void);
+void c_scheduler_start(void);
+_task_t *c_task_current(void);
+_task_t *c_task_get(_task_id_t id);
 uint32_t c_scheduler(_ctx_t *);
+uint32_t c_scheduler_yield(_ctx_t *);
+void c_task_block(uintptr_t key, _task_id_t hint);
+uint32_t c_task_wake(uintptr_t key, uint32_t count);
+// Sets the r0 a switched-out task resumes with, for a system call that
+// completes after the task blocked
+void c_task_set_result(_task_t *task, uint32_t value);
+void c_task_stop(void);
+void c_sched_kick(_task_id_t hint);
+int32_t c_task_clone(_task_ptr_t entry, uint32_t arg);
+uint32_t c_scheduler_bench(uint32_t count);
 void c_systick_handler();
 _systick_t c_systick_get();
 void c_delay(_systick_t ticks);
@@ -0,0 +1,59 @@
+#ifndef __SEM_LIB_H
+#define __SEM_LIB_H
+
+#include "atomic.h"
+#include "syscall.h"
+#include <stdint.h>
+
+// User-space counting semaphore
+// Waiters sleep on the count while it is 0, sem_post() only enters the
+// kernel when someone is sleeping.
+
+#define SEM_INIT(n) {(n), 0}
+
+typedef struct {
+  volatile uint32_t count;
+  volatile uint32_t waiters;
+} _sem_t;
+
+__attribute__((always_inline)) static inline void sem_wait(_sem_t *s) {
+  while (1) {
+    uint32_t cur = s->count;
+    if (cur != 0) {
+      if (atomic_cas(&s->count, cur, cur - 1) == cur) {
+        break;
+      }
+      continue;
+    }
+    atomic_add(&s->waiters, 1);
+    // Returns straight away if a post came in since the count was read
+    SYSCALL3(SYS_FUTEX_WAIT, &s->count, 0, 0);
+    atomic_sub(&s->waiters, 1);
+  }
+  atomic_barrier();
+}
+
+__attribute__((always_inline)) static inline uint32_t
+sem_trywait(_sem_t *s) {
+  uint32_t cur = s->count;
+  while (cur != 0) {
+    uint32_t old = atomic_cas(&s->count, cur, cur - 1);
+    if (old == cur) {
+      atomic_barrier();
+      return 1;
+    }
+    cur = old;
+  }
+  return 0;
+}
+
+__attribute__((always_inline)) static inline void sem_post(_sem_t *s) {
+  atomic_barrier();
+  atomic_add(&s->count, 1);
+  atomic_barrier();
+  if (s->waiters != 0) {
+    SYSCALL2(SYS_FUTEX_WAKE, &s->count, 1);
+  }
+}
+
+#endif // __SEM_LIB_H
@@ -0,0 +1,39 @@
+#ifndef __SEMIHOST_LIB_H
+#define __SEMIHOST_LIB_H
+
+#include <stdint.h>
+
+// ARM semihosting, QEMU needs `-semihosting`.
+// https://developer.arm.com/documentation/dui0471/m/what-is-semihosting-/what-is-semihosting-
+// Without it the call ends up in c_swi_handler(), which fails it with -1.
+
+#define SEMIHOST_SVC 0x123456
+
+// Operations
+#define SEMIHOST_SYS_OPEN 0x01
+#define SEMIHOST_SYS_CLOSE 0x02
+#define SEMIHOST_SYS_WRITE0 0x04
+#define SEMIHOST_SYS_WRITE 0x05
+#define SEMIHOST_SYS_EXIT 0x18
+
+// SYS_OPEN modes, as the fopen() modes
+#define SEMIHOST_OPEN_RB 1
+#define SEMIHOST_OPEN_WB 5
+#define SEMIHOST_OPEN_AB 9
+
+// Reason codes for SYS_EXIT, QEMU exits with 0 for the first one and 1
+// otherwise
+#define ADP_STOPPED_APPLICATION_EXIT 0x20026
+#define ADP_STOPPED_RUN_TIME_ERROR 0x20023
+
+uint32_t c_semihost_call(uint32_t op, uint32_t arg);
+void c_semihost_exit(uint32_t reason);
+// Host files: open returns a handle or -1, write returns the number of bytes
+// not written (0 on success), close returns 0 or -1.
+int32_t c_semihost_open(const char *path, uint32_t mode);
+uint32_t c_semihost_write(int32_t handle, const void *buf, uint32_t size);
+int32_t c_semihost_close(int32_t handle);
+// Null terminated string to the host's debug console
+void c_semihost_write0(const char *s);
+
+#endif // __SEMIHOST_LIB_H
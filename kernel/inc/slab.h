@@ -0,0 +1,36 @@
+#ifndef __SLAB_LIB_H
+#define __SLAB_LIB_H
+
+#include <stdint.h>
+
+// Slab allocator
+// One cache per object type. A cache grows one page (slab) at a time from
+// the page allocator, carving it into objects of the cache's size rounded up
+// to SLAB_ALIGN, so objects never share a cache line. Free objects are
+// chained through their first word, alloc and free are O(1).
+// Slabs are not given back to the page allocator.
+
+#define SLAB_ALIGN 64 // Cortex-A8 cache line
+
+typedef struct _slab_cache {
+  const char *name;
+  uint32_t obj_size;
+  uint32_t objs_per_slab;
+  void *free_list;
+  // Statistics
+  uint32_t slabs;
+  uint32_t in_use;
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t failures;
+  struct _slab_cache *next; // All caches, for c_slab_stats()
+} _slab_cache_t;
+
+void c_slab_cache_init(_slab_cache_t *cache, const char *name, uint32_t size);
+// Returns NULL when the kernel heap is exhausted
+void *c_slab_alloc(_slab_cache_t *cache);
+void c_slab_free(_slab_cache_t *cache, void *obj);
+// Logs the statistics of every cache
+void c_slab_stats(void);
+
+#endif // __SLAB_LIB_H
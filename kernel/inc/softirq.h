@@ -0,0 +1,42 @@
+#ifndef __SOFTIRQ_LIB_H
+#define __SOFTIRQ_LIB_H
+
+#include <stdint.h>
+
+// Deferred work
+// Top halves in c_irq_handler() only acknowledge their device and raise a
+// softirq. The pending softirqs are one bitmap, the bit number is the
+// priority (SOFTIRQ_TIMER runs first). At IRQ exit c_softirq_irq_exit()
+// wakes the kworker kernel task and makes it the next to run. It runs the
+// pending softirqs in priority order with IRQs enabled, then the queued work
+// items. Both may take as long as they need, a work item may also block.
+
+enum {
+  SOFTIRQ_TIMER, // Software timer callbacks (swtimer.h)
+  SOFTIRQ_DMA,   // DMA completion callbacks (dma.h)
+  SOFTIRQ_COUNT,
+};
+
+typedef void (*_softirq_handler_t)(void);
+
+typedef struct _work {
+  struct _work *next;
+  void (*fn)(struct _work *work);
+  uint32_t queued;
+} _work_t;
+
+void c_softirq_register(uint32_t nr, _softirq_handler_t handler);
+// Safe from IRQ context
+void c_softirq_raise(uint32_t nr);
+// Called last in c_irq_handler()
+void c_softirq_irq_exit(void);
+
+void c_work_init(_work_t *work, void (*fn)(_work_t *work));
+// Queues the work for the kworker, does nothing if it is already queued.
+// Safe from IRQ context.
+void c_work_queue(_work_t *work);
+
+// Kernel task entrypoint (kernel/tasks.c)
+void task_kworker(void);
+
+#endif // __SOFTIRQ_LIB_H
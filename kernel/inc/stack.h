@@ -0,0 +1,27 @@
+#ifndef __STACK_LIB_H
+#define __STACK_LIB_H
+
+#include "mmu.h"
+#include "sched.h"
+#include <stdint.h>
+
+// Task stacks
+// c_task_init() paints the task part of every stack (below the IRQ frame) with
+// STACK_PAINT. The deepest word that lost the pattern is the high-water mark,
+// reported by c_stack_report() and SYS_STACK_REPORT.
+// The page below a user task's stack is left unmapped. An overflow into it
+// takes a data abort, c_abort_handler() logs it and stops the task. Kernel
+// tasks share the kernel stack region and only get the high-water mark.
+
+#define STACK_PAINT 0x57AC57AC
+#define STACK_GUARD_SIZE 0x1000
+// The idle task reports every STACK_REPORT_TICKS ticks (STACKS=1)
+#define STACK_REPORT_TICKS 1000u
+
+void c_stack_paint(const _task_t *task);
+int32_t c_stack_map(mmu_tables_t *tables, const _task_t *task);
+uint32_t c_stack_guard_hit(const _task_t *task, uint32_t fault_addr);
+uint32_t c_stack_used(const _task_t *task);
+void c_stack_report(void);
+
+#endif // __STACK_LIB_H
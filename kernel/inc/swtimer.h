@@ -0,0 +1,49 @@
+#ifndef __SWTIMER_LIB_H
+#define __SWTIMER_LIB_H
+
+#include "sched.h"
+#include <stdint.h>
+
+// Software timers
+// Hierarchical timing wheel driven by the systick: SWTIMER_LEVELS levels of
+// SWTIMER_SLOTS slots, level n covering timeouts up to SWTIMER_SLOTS^(n+1)
+// ticks. Adding and cancelling a timer are O(1) list operations, and a tick
+// only touches the current slot (plus one cascade every SWTIMER_SLOTS ticks),
+// so the per-tick cost does not grow with the number of timers.
+// Expired timers are queued and their callbacks run from
+// c_swtimer_run_expired(), the SOFTIRQ_TIMER handler (softirq.h), outside
+// the timer top half.
+
+#define SWTIMER_SLOT_BITS 6
+#define SWTIMER_SLOTS (1 << SWTIMER_SLOT_BITS)
+#define SWTIMER_SLOT_MASK (SWTIMER_SLOTS - 1)
+#define SWTIMER_LEVELS 4
+// Longer timeouts are clamped
+#define SWTIMER_MAX_TICKS ((1u << (SWTIMER_SLOT_BITS * SWTIMER_LEVELS)) - 1)
+
+typedef void (*_swtimer_cb_t)(void *arg);
+
+typedef struct _swtimer_link {
+  struct _swtimer_link *next;
+  struct _swtimer_link *prev;
+} _swtimer_link_t;
+
+typedef struct {
+  _swtimer_link_t link; // Has to be the first member
+  _systick_t expires;
+  _swtimer_cb_t callback;
+  void *arg;
+} _swtimer_t;
+
+void c_swtimer_wheel_init(void);
+void c_swtimer_init(_swtimer_t *timer, _swtimer_cb_t callback, void *arg);
+// Timers allocated from the kernel heap, NULL when it is exhausted
+_swtimer_t *c_swtimer_create(_swtimer_cb_t callback, void *arg);
+void c_swtimer_destroy(_swtimer_t *timer);
+void c_swtimer_add(_swtimer_t *timer, _systick_t ticks);
+void c_swtimer_cancel(_swtimer_t *timer);
+uint32_t c_swtimer_pending(const _swtimer_t *timer);
+void c_swtimer_tick(void);
+void c_swtimer_run_expired(void);
+
+#endif // __SWTIMER_LIB_H
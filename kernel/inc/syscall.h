@@ -0,0 +1,63 @@
+#ifndef __SYSCALL_LIB_H
+#define __SYSCALL_LIB_H
+
+#include <stdint.h>
+
+// System call numbers, encoded in the swi immediate.
+// Numbers without a handler (e.g. the 0x1/0x2 used by task1/task2) are only
+// logged.
+#define SYS_PROF_DUMP 0x10
+#define SYS_NOP 0x11 // Does nothing, used to time the system call path
+#define SYS_LAT_REPORT 0x12 // r0: clear the histograms after the report
+#define SYS_FUTEX_WAIT 0x13 // futex.h
+#define SYS_FUTEX_WAKE 0x14
+#define SYS_HEAP_STATS 0x15 // Logs the kernel heap and slab statistics
+#define SYS_BRK 0x16          // vm.h
+#define SYS_MMAP 0x17
+#define SYS_UART_WRITE 0x18 // dma.h, r0: buffer, r1: size
+#define SYS_STACK_REPORT 0x19 // Logs every task's stack high-water mark
+#define SYS_CLONE 0x1A // r0: entry (0: image entrypoint), r1: its r0, vm.h
+#define SYS_CLOCK_RAW 0x1B // Raw clocksource count, clock.h (zynq only)
+#define SYS_TRACE 0x1C // r0: tracepoint mask, r1: dump first, trace.h
+#define SYS_URING_SETUP 0x1D // r0: flags, uring.h
+#define SYS_URING_ENTER 0x1E // r0: completions to wait for
+
+// Arguments are passed in r0-r3, the result is returned in r0.
+uint32_t c_swi_handler(uint32_t number, uint32_t *args);
+
+// User side
+// Macros rather than functions, so the swi is emitted inside the calling
+// task's own section. lr is listed because a kernel task (SVC mode) loses its
+// banked lr on the swi.
+#define SYSCALL0(nr)                                                           \
+  ({                                                                           \
+    register uint32_t _r0 asm("r0");                                           \
+    asm volatile("swi %1" : "=r"(_r0) : "i"(nr) : "lr", "memory");             \
+    _r0;                                                                       \
+  })
+#define SYSCALL1(nr, a0)                                                       \
+  ({                                                                           \
+    register uint32_t _r0 asm("r0") = (uint32_t)(a0);                          \
+    asm volatile("swi %1" : "+r"(_r0) : "i"(nr) : "lr", "memory");             \
+    _r0;                                                                       \
+  })
+#define SYSCALL2(nr, a0, a1)                                                   \
+  ({                                                                           \
+    register uint32_t _r0 asm("r0") = (uint32_t)(a0);                          \
+    register uint32_t _r1 asm("r1") = (uint32_t)(a1);                          \
+    asm volatile("swi %2" : "+r"(_r0) : "r"(_r1), "i"(nr) : "lr", "memory");   \
+    _r0;                                                                       \
+  })
+#define SYSCALL3(nr, a0, a1, a2)                                               \
+  ({                                                                           \
+    register uint32_t _r0 asm("r0") = (uint32_t)(a0);                          \
+    register uint32_t _r1 asm("r1") = (uint32_t)(a1);                          \
+    register uint32_t _r2 asm("r2") = (uint32_t)(a2);                          \
+    asm volatile("swi %3"                                                      \
+                 : "+r"(_r0)                                                   \
+                 : "r"(_r1), "r"(_r2), "i"(nr)                                 \
+                 : "lr", "memory");                                            \
+    _r0;                                                                       \
+  })
+
+#endif // __SYSCALL_LIB_H
@@ -4,14 +4,16 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define CTRL_IRQ_ENABLE (1 << 7u)
+#include "board.h"
+
+// Systick timer, reloaded with TIMER_TICK_LOAD and raising GIC_SOURCE_TICK
+// every time it reaches zero
+#define TIMER_TICK_LOAD 0x00010000
 
 #define reserved_bits(x, y, z) uint8_t reserved##x[z - y + 1];
 
-#define TIMER0_ADDR 0x10011000
-#define TIMER1_ADDR 0x10012000
-#define TIMER2_ADDR 0x10018000
-#define TIMER3_ADDR 0x10019000
+#ifdef BOARD_TIMER_SP804
+#define CTRL_IRQ_ENABLE (1 << 7u)
 
 typedef volatile struct {
   uint32_t Timer1Load;
@@ -36,7 +38,58 @@ typedef volatile struct {
   uint32_t PeriphID[4];
   uint32_t PCellID[4];
 } _timer_t;
+#endif
+
+#ifdef BOARD_TIMER_A9
+// Cortex-A9 private and global timers, Control
+#define A9_TIMER_ENABLE (1 << 0u)
+#define A9_TIMER_AUTO_RELOAD (1 << 1u)
+#define A9_TIMER_IRQ_ENABLE (1 << 2u)
+#define A9_TIMER_PRESCALER(p) ((p) << 8u)
+
+// Counts down from Load
+typedef volatile struct {
+  uint32_t Load;
+  uint32_t Counter;
+  uint32_t Control;
+  uint32_t IntStatus;
+} _ptimer_t;
+
+// 64-bit up counter
+typedef volatile struct {
+  uint32_t CounterLo;
+  uint32_t CounterHi;
+  uint32_t Control;
+  uint32_t IntStatus;
+  uint32_t ComparatorLo;
+  uint32_t ComparatorHi;
+  uint32_t AutoIncrement;
+} _gtimer_t;
+#endif
 
 void c_timer_init();
 
+// Clears the systick interrupt
+__attribute__((always_inline)) static inline void timer_tick_ack(void) {
+#ifdef BOARD_TIMER_SP804
+  _timer_t *const TIMER0 = (_timer_t *)TIMER0_ADDR;
+  TIMER0->Timer1IntClr = 0x1;
+#else
+  _ptimer_t *const PTIMER = (_ptimer_t *)PTIMER_ADDR;
+  PTIMER->IntStatus = 0x1;
+#endif
+}
+
+// Counts since the systick last reloaded
+__attribute__((always_inline)) static inline uint32_t
+timer_tick_elapsed(void) {
+#ifdef BOARD_TIMER_SP804
+  _timer_t *const TIMER0 = (_timer_t *)TIMER0_ADDR;
+  return TIMER0->Timer1Load - TIMER0->Timer1Value;
+#else
+  _ptimer_t *const PTIMER = (_ptimer_t *)PTIMER_ADDR;
+  return PTIMER->Load - PTIMER->Counter;
+#endif
+}
+
 #endif // __TIMER_LIB_H
@@ -0,0 +1,68 @@
+#ifndef __TRACE_LIB_H
+#define __TRACE_LIB_H
+
+#include <stdint.h>
+
+// Static tracepoints
+// A tracepoint is a single nop in the instrumented function, listed with its
+// id in the .tracepoints table (linker/mmap.ld). SYS_TRACE patches the nops
+// of the enabled ids into a `bl _trace_entry` (core/trace.s), and back, with
+// the D-cache cleaned and the I-cache and branch predictor invalidated for
+// the patched word. _trace_entry saves every register but lr, which the
+// tracepoint marks as clobbered, and calls c_trace_hit().
+// Hits go into a ring of the last TRACE_EVENTS events, dumped over UART0 as
+//   TRACE <time us> <id> <arg> <site>
+// oldest first, numbers in hex.
+
+#define TRACE_EVENTS 64
+
+enum {
+  TRACE_IRQ,          // arg: GIC interrupt id
+  TRACE_SYSCALL,      // arg: system call number
+  TRACE_SCHED_SWITCH, // arg: id of the next task
+  TRACE_MAP_REGION,   // arg: virtual address
+  TRACE_IDS,
+};
+
+#define TRACE_ALL ((1u << TRACE_IDS) - 1)
+
+typedef struct {
+  uint32_t site; // Address of the patched instruction
+  uint32_t id;
+} _tracepoint_t;
+
+typedef struct {
+  uint32_t time_us;
+  uint32_t id;
+  uint32_t arg;
+  uint32_t site;
+} _trace_event_t;
+
+// A nop with nothing else around it
+#define TRACEPOINT(id) TRACEPOINT_ASM(id)
+
+// The argument has to be in r0 when the tracepoint is hit, which costs
+// the move into r0 even while the tracepoint is a nop
+#define TRACEPOINT_ARG(id, arg)                                                \
+  do {                                                                         \
+    register uint32_t _trace_arg asm("r0") = (uint32_t)(arg);                  \
+    TRACEPOINT_ASM(id, "r"(_trace_arg));                                       \
+  } while (0)
+
+#define TRACEPOINT_ASM(id, ...)                                                \
+  asm volatile("1: nop\n\t"                                                    \
+               ".pushsection .tracepoints, \"aw\"\n\t"                         \
+               ".word 1b, %c0\n\t"                                             \
+               ".popsection" ::"i"(id),                                        \
+               ##__VA_ARGS__                                                   \
+               : "lr")
+
+// Enables the tracepoints of the ids in `mask` and disables the others.
+// Returns the previous mask.
+uint32_t c_trace_enable(uint32_t mask);
+// Logs the recorded events and empties the ring
+void c_trace_dump(void);
+// Called by _trace_entry
+void c_trace_hit(uint32_t arg, uint32_t site);
+
+#endif // __TRACE_LIB_H
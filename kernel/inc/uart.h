@@ -3,8 +3,9 @@
 
 #include <stdint.h>
 
-#define UART0_ADDR 0x10009000
+#include "board.h"
 
+#ifdef BOARD_UART_PL011
 #define FR_BUSY (1 << 3u)
 #define LCRH_FEN (1 << 4u)
 #define CR_UARTEN (1 << 0u)
@@ -23,6 +24,38 @@ typedef struct {
   uint32_t LCRH;
   uint32_t CR;
 } _uart_t;
+#endif
+
+#ifdef BOARD_UART_CDNS
+// Cadence UART (Zynq-7000 TRM, Appendix B.33)
+#define CDNS_CR_RXRST (1 << 0u)
+#define CDNS_CR_TXRST (1 << 1u)
+#define CDNS_CR_RX_EN (1 << 2u)
+#define CDNS_CR_RX_DIS (1 << 3u)
+#define CDNS_CR_TX_EN (1 << 4u)
+#define CDNS_CR_TX_DIS (1 << 5u)
+// 8 data bits, no parity, one stop bit
+#define CDNS_MR_8N1 (0b100 << 3u)
+#define CDNS_SR_RXEMPTY (1 << 1u)
+#define CDNS_SR_TXFULL (1 << 4u)
+
+typedef volatile struct {
+  uint32_t CR;
+  uint32_t MR;
+  uint32_t IER;
+  uint32_t IDR;
+  uint32_t IMR;
+  uint32_t ISR;
+  uint32_t BAUDGEN;
+  uint32_t RXTOUT;
+  uint32_t RXWM;
+  uint32_t MODEMCR;
+  uint32_t MODEMSR;
+  uint32_t SR;
+  uint32_t FIFO;
+  uint32_t BAUDDIV;
+} _uart_t;
+#endif
 
 // Function Definitions
 void c_UART0_init();
@@ -0,0 +1,119 @@
+#ifndef __URING_LIB_H
+#define __URING_LIB_H
+
+#include "atomic.h"
+#include "sched.h"
+#include "syscall.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Submission rings
+// A task batches its kernel requests through a page it shares with the
+// kernel instead of paying one SVC round trip per request.
+//   SYS_URING_SETUP(flags): maps the task's _uring_t at URING_VMA (user
+//     read/write, never executable), returns URING_VMA or VM_MAP_FAILED.
+//   SYS_URING_ENTER(min_complete): the kernel consumes every queued
+//     submission, then blocks the task until min_complete completions wait
+//     in the CQ or nothing is left in flight. Returns the entries consumed.
+// The task fills sq[] and moves sq_tail, the kernel answers every entry
+// with one cq[] entry carrying its user_data, and the task reaps them by
+// moving cq_head, without a system call. Entries are only consumed while
+// the CQ has room for their completion, so it never overflows.
+// With URING_SQPOLL the timer tick also drains the queue of the task it
+// interrupted, in IRQ mode on the task's tables. It only runs the ops that
+// cost a bounded time (NOP, SLEEP, FUTEX_WAKE, and WRITE where it is a DMA
+// submission) and stops at the first other one, which waits for
+// SYS_URING_ENTER. A task queuing only those never enters the kernel.
+
+#define URING_VMA 0x70B00000
+// Powers of two
+#define URING_SQ_ENTRIES 16
+#define URING_CQ_ENTRIES 32
+
+// SYS_URING_SETUP flags
+#define URING_SQPOLL (1 << 0u)
+
+// Each op behaves as the system call it stands for, `res` is its result
+enum {
+  URING_OP_NOP,        // res 0
+  URING_OP_WRITE,      // SYS_UART_WRITE: arg[0] buffer, arg[1] size
+  URING_OP_SLEEP,      // arg[0] ticks, res 0 once they have passed
+  URING_OP_FUTEX_WAKE, // SYS_FUTEX_WAKE: arg[0] address, arg[1] count
+  URING_OP_MMAP,       // SYS_MMAP: arg[0] size
+  URING_OPS,
+};
+
+// Past the errors of the system calls above
+#define URING_ERROR_OP -8     // Unknown op
+#define URING_ERROR_NORING -9 // SYS_URING_ENTER before SYS_URING_SETUP
+
+typedef struct {
+  uint32_t op;
+  uint32_t arg[2];
+  uint32_t user_data; // Handed back in the completion
+} _uring_sqe_t;
+
+typedef struct {
+  uint32_t user_data;
+  int32_t res;
+} _uring_cqe_t;
+
+// The shared page. The task owns sq_tail and cq_head, the kernel sq_head
+// and cq_tail.
+typedef volatile struct {
+  uint32_t sq_head;
+  uint32_t sq_tail;
+  uint32_t cq_head;
+  uint32_t cq_tail;
+  _uring_sqe_t sq[URING_SQ_ENTRIES];
+  _uring_cqe_t cq[URING_CQ_ENTRIES];
+} _uring_t;
+
+uint32_t c_uring_setup(uint32_t flags);
+uint32_t c_uring_enter(uint32_t min_complete);
+// Called on the timer tick, with the interrupted task current
+void c_uring_poll(void);
+
+// User side
+// Next free submission entry, NULL while the queue is full
+__attribute__((always_inline)) static inline volatile _uring_sqe_t *
+uring_get_sqe(_uring_t *ring) {
+  uint32_t tail = ring->sq_tail;
+  if (tail - ring->sq_head == URING_SQ_ENTRIES) {
+    return NULL;
+  }
+  return &ring->sq[tail & (URING_SQ_ENTRIES - 1)];
+}
+
+// Publishes the entry uring_get_sqe() returned
+__attribute__((always_inline)) static inline void
+uring_sqe_commit(_uring_t *ring) {
+  atomic_barrier();
+  ring->sq_tail++;
+}
+
+__attribute__((always_inline)) static inline uint32_t
+uring_enter(uint32_t min_complete) {
+  return SYSCALL1(SYS_URING_ENTER, min_complete);
+}
+
+// Oldest completion, NULL when there is none
+__attribute__((always_inline)) static inline volatile _uring_cqe_t *
+uring_peek_cqe(_uring_t *ring) {
+  uint32_t head = ring->cq_head;
+  if (head == ring->cq_tail) {
+    return NULL;
+  }
+  atomic_barrier();
+  return &ring->cq[head & (URING_CQ_ENTRIES - 1)];
+}
+
+// Hands the entry uring_peek_cqe() returned back to the kernel
+__attribute__((always_inline)) static inline void
+uring_cqe_seen(_uring_t *ring) {
+  atomic_barrier();
+  ring->cq_head++;
+}
+
+#endif // __URING_LIB_H
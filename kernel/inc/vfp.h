@@ -0,0 +1,29 @@
+#ifndef __VFP_LIB_H
+#define __VFP_LIB_H
+
+#include "sched.h"
+#include <stdint.h>
+
+// CPACR: full access to cp10 and cp11 (VFP/NEON)
+#define CPACR_CP10_CP11_FULL (0xF << 20u)
+
+#define VFP_D_REGISTERS 32
+
+// FP state of a task, saved and restored by core/vfp.s
+typedef struct {
+  uint64_t d[VFP_D_REGISTERS];
+  uint32_t fpscr;
+} _vfp_ctx_t;
+
+// core/vfp.s
+void _vfp_enable(void);
+void _vfp_disable(void);
+uint32_t _vfp_is_enabled(void);
+void _vfp_save(_vfp_ctx_t *ctx);
+void _vfp_restore(_vfp_ctx_t *ctx);
+
+void c_vfp_init(void);
+void c_vfp_switch(_task_id_t next_id);
+uint32_t c_vfp_trap(uint32_t instr);
+
+#endif // __VFP_LIB_H
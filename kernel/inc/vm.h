@@ -0,0 +1,42 @@
+#ifndef __VM_LIB_H
+#define __VM_LIB_H
+
+#include "sched.h"
+#include <stdint.h>
+
+// Task heaps
+// Every task gets a TASK_HEAP_SIZE window at TASK_HEAP_VMA, backed on demand
+// with zeroed pages from the user page pool. The program break grows up
+// from the bottom of the window (SYS_BRK), anonymous mappings are handed out
+// from the top down (SYS_MMAP), and the two must not meet.
+
+#define TASK_HEAP_VMA 0x70C00000
+#define TASK_HEAP_SIZE 0x100000 // One L2 table
+
+#define VM_MAP_FAILED ((uint32_t)-1)
+#define VM_ERROR_NO_MEMORY -4 // Next to the mmu.h paging errors
+#define VM_ERROR_FAULT -5     // Not a copy-on-write page
+
+// Copy-on-write
+// A clone (c_task_clone()) starts with a copy of its parent's tables. Every
+// page both could write becomes read-only in both, and the first write to
+// it faults into c_vm_cow_fault(), which gives the writer its own copy. User
+// pool pages are reference counted, so the last task sharing one just gets
+// write access back. Image pages (.data, .bss) have no count, every writer
+// copies them. The clone gets a fresh stack at the parent's stack VMA, and
+// no submission ring (uring.h).
+
+// Moves the break to `addr` and returns the new break. addr 0 only returns
+// it, on failure the break is left where it was. Lowering it returns the
+// whole pages above the new break to the pool.
+uint32_t c_vm_brk(uint32_t addr);
+// Maps `size` bytes of zeroed memory, returns its address or VM_MAP_FAILED
+uint32_t c_vm_mmap(uint32_t size);
+int32_t c_vm_clone(_task_t *parent, _task_t *child);
+// Drops the user pages of a clone that never ran, its stack included, for
+// a c_task_clone() that fails after c_vm_clone()
+void c_vm_clone_undo(_task_t *child);
+// Called by c_abort_handler() on a write permission fault
+int32_t c_vm_cow_fault(uint32_t addr);
+
+#endif // __VM_LIB_H
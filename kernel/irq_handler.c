@@ -1,27 +1,62 @@
+#include "inc/bench.h"
+#include "inc/dma.h"
 #include "inc/gic.h"
+#include "inc/latency.h"
+#include "inc/prof.h"
+#include "inc/rs.h"
 #include "inc/sched.h"
+#include "inc/softirq.h"
 #include "inc/timer.h"
+#include "inc/trace.h"
 #include "inc/uart.h"
+#include "inc/uring.h"
 // CTX should have a struct that reflects the pushed data inside the
 // asm_irq_handler
 __attribute__((section(".text._irq_handler"))) uint32_t
 c_irq_handler(_ctx_t *ctx) {
   _gicc_t *const GICC0 = (_gicc_t *)GICC0_ADDR;
-  _timer_t *const TIMER0 = (_timer_t *)TIMER0_ADDR;
 
   // Interrupt acknowledge register
   // It tells whcih interrupt id has been triggered
   uint32_t id = GICC0->IAR;
+  TRACEPOINT_ARG(TRACE_IRQ, id);
 
   uint32_t ret_sp = (uint32_t)ctx->sp;
 
   switch (id) {
-  case GIC_SOURCE_TIMER0:
-    TIMER0->Timer1IntClr = 0x1;
+  case GIC_SOURCE_TICK:
+    c_lat_irq_entry();
+    timer_tick_ack();
     c_systick_handler();
+    // ctx->lr holds the interrupted PC
+    c_prof_sample(c_task_current()->id, (uint32_t)ctx->lr);
+    // URING_SQPOLL rings, before the task is switched out
+    c_uring_poll();
     ret_sp = c_scheduler(ctx);
     break;
 
+#ifdef BOARD_HAS_DMA
+  case GIC_SOURCE_DMA:
+    c_dma_irq();
+    break;
+#endif
+
+#ifdef CONFIG_RS
+  case GIC_SOURCE_UART0:
+    rs_uart_irq();
+    break;
+#endif
+
+  case GIC_SGI_RESCHED:
+    ret_sp = c_scheduler_yield(ctx);
+    break;
+
+#ifdef CONFIG_BENCH
+  case BENCH_SGI:
+    c_bench_irq();
+    break;
+#endif
+
   default:
     break;
   }
@@ -32,5 +67,12 @@ c_irq_handler(_ctx_t *ctx) {
   // register in the interrupting GIC
   GICC0->EOIR = id;
 
+  // Bottom halves (software timer callbacks, DMA completions) run in the
+  // kworker task, with IRQs enabled
+  c_softirq_irq_exit();
+
+  if (id == GIC_SOURCE_TICK) {
+    c_lat_irq_resume();
+  }
   return ret_sp;
 }
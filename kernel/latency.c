@@ -0,0 +1,125 @@
+#include "inc/latency.h"
+#include "../sys/inc/logger.h"
+#include "inc/timer.h"
+#include "inc/uart.h"
+
+#ifdef CONFIG_LATENCY
+static _lat_hist_t lat_entry;
+static _lat_hist_t lat_resume;
+
+// Values below LAT_SUB_BUCKETS get their own bucket, the rest are split by
+// their most significant bit and the LAT_SUB_BITS bits below it.
+static inline uint32_t lat_bucket(uint32_t val) {
+  if (val < LAT_SUB_BUCKETS) {
+    return val;
+  }
+  uint32_t msb = 31 - __builtin_clz(val);
+  uint32_t bucket = ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+                    ((val >> (msb - LAT_SUB_BITS)) & (LAT_SUB_BUCKETS - 1));
+  return bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS - 1;
+}
+
+// Lowest value of a bucket
+static uint32_t lat_bucket_floor(uint32_t bucket) {
+  if (bucket < LAT_SUB_BUCKETS) {
+    return bucket;
+  }
+  uint32_t msb = (bucket >> LAT_SUB_BITS) + LAT_SUB_BITS - 1;
+  uint32_t sub = bucket & (LAT_SUB_BUCKETS - 1);
+  return (LAT_SUB_BUCKETS + sub) << (msb - LAT_SUB_BITS);
+}
+
+static inline void lat_record(_lat_hist_t *hist, uint32_t val) {
+  if (hist->count == 0 || val < hist->min) {
+    hist->min = val;
+  }
+  if (val > hist->max) {
+    hist->max = val;
+  }
+  hist->count++;
+  hist->sum += val;
+  hist->buckets[lat_bucket(val)]++;
+}
+
+// Shift and subtract division, there is no hardware divider nor libgcc
+static uint32_t lat_div(uint64_t num, uint32_t den) {
+  uint64_t quot = 0;
+  uint64_t rem = 0;
+
+  for (int32_t bit = 63; bit >= 0; bit--) {
+    rem = (rem << 1) | ((num >> bit) & 1);
+    if (rem >= den) {
+      rem -= den;
+      quot |= 1ull << bit;
+    }
+  }
+  return (uint32_t)quot;
+}
+
+static void lat_print(const char *name, _lat_hist_t *hist) {
+  c_puts("LAT ");
+  c_puts(name);
+  if (hist->count == 0) {
+    c_putsln(" no samples");
+    return;
+  }
+
+  // Smallest bucket with at least 99% of the samples at or below it
+  uint32_t target = hist->count - lat_div(hist->count, 100);
+  uint32_t seen = 0;
+  uint32_t p99 = 0;
+  for (uint32_t i = 0; i < LAT_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if (seen >= target) {
+      p99 = lat_bucket_floor(i);
+      break;
+    }
+  }
+
+  c_puts(" n=");
+  c_puts_hex(hist->count);
+  c_puts(" min=");
+  c_puts_hex(hist->min);
+  c_puts(" avg=");
+  c_puts_hex(lat_div(hist->sum, hist->count));
+  c_puts(" p99=");
+  c_puts_hex(p99);
+  c_puts(" max=");
+  c_puts_hex(hist->max);
+  c_putchar('\n');
+}
+
+static void lat_clear(_lat_hist_t *hist) {
+  hist->count = 0;
+  hist->min = 0;
+  hist->max = 0;
+  hist->sum = 0;
+  for (uint32_t i = 0; i < LAT_BUCKETS; i++) {
+    hist->buckets[i] = 0;
+  }
+}
+
+// Called first thing in the timer IRQ, right after IAR
+__attribute__((section(".kernel.text"))) void c_lat_irq_entry(void) {
+  lat_record(&lat_entry, timer_tick_elapsed());
+}
+
+// Called last in the timer IRQ, the task picked by c_scheduler() runs next
+__attribute__((section(".kernel.text"))) void c_lat_irq_resume(void) {
+  lat_record(&lat_resume, timer_tick_elapsed());
+}
+
+__attribute__((section(".kernel.text"))) void c_lat_report(uint32_t reset) {
+  // In timer counts (us)
+  lat_print("entry", &lat_entry);
+  lat_print("resume", &lat_resume);
+  if (reset) {
+    lat_clear(&lat_entry);
+    lat_clear(&lat_resume);
+  }
+}
+#else
+__attribute__((section(".kernel.text"))) void c_lat_report(uint32_t reset) {
+  c_log_warn("Latency measurement not built, use LATENCY=1");
+}
+#endif
@@ -0,0 +1,54 @@
+#include "inc/loader.h"
+#include "../sys/inc/logger.h"
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_loader_l2_flags(uint32_t seg_flags) {
+  uint32_t l2_flags = L2_SMALL_PAGE_BASE;
+
+  if (seg_flags & SEG_USER) {
+    l2_flags |= (seg_flags & SEG_WRITE) ? USR_RW : USR_RO;
+  } else {
+    l2_flags |= (seg_flags & SEG_WRITE) ? KRN_RW : KRN_RO;
+  }
+  if ((seg_flags & SEG_EXEC) == 0) {
+    l2_flags |= L2_XN;
+  }
+  return l2_flags;
+}
+
+// Loads a task image into its physical memory and fills the task's tables.
+// Runs before the MMU is enabled, so the LMA and PHY addresses are accessed
+// directly.
+__attribute__((section(".kernel.text"))) int32_t
+c_loader_load(const _task_image_t *image, mmu_tables_t *tables) {
+  c_mmu_fill_tables(tables);
+
+  for (uint32_t i = 0; i < image->segment_count; i++) {
+    const _task_segment_t *seg = &image->segments[i];
+
+    if (seg->flags & SEG_LOAD) {
+      copy_lma_into_phy((void *)seg->phy, (const void *)seg->lma, seg->size);
+    } else if (seg->flags & SEG_ZERO) {
+      // clear_memory() works on words
+      clear_memory((void *)seg->phy, (seg->size + 3) & ~3u);
+    }
+
+    c_log_mapping("Task segment", seg->vma, seg->phy, seg->size);
+    int32_t ret = map_region(tables, seg->vma, seg->phy, seg->size,
+                             c_loader_l2_flags(seg->flags));
+    if (ret != PAGING_SUCCESS) {
+      return ret;
+    }
+  }
+
+  // Kernel tasks use a stack inside the kernel stack region, which is already
+  // mapped by c_mmu_fill_tables().
+  if ((image->flags & TASK_KERNEL) == 0) {
+    c_log_mapping("Task stack", image->stack.vma, image->stack.phy,
+                  image->stack.size);
+    return map_region(tables, image->stack.vma, image->stack.phy,
+                      image->stack.size,
+                      c_loader_l2_flags(image->stack.flags | SEG_USER));
+  }
+  return PAGING_SUCCESS;
+}
@@ -0,0 +1,289 @@
+#include "inc/membench.h"
+#include "inc/clock.h"
+#include "inc/dma.h"
+#include "inc/syscall.h"
+
+// Runs in USR mode from the user tasks: only system calls, no kernel calls.
+// The tasks cannot read the kernel's .rodata, so the constant data sits in
+// .ulib.text.rodata and no string literal is used.
+
+typedef void (*_mb_kernel_t)(uint32_t *dst, const uint32_t *a,
+                             const uint32_t *b, uint32_t bytes);
+typedef void (*_mb_fill_t)(uint32_t *dst, uint32_t pattern, uint32_t bytes);
+
+typedef struct {
+  const char *name;
+  uint32_t arrays; // Arrays read or written per element
+  _mb_kernel_t fn[MEMBENCH_VARIANTS];
+} _mb_stream_t;
+
+typedef struct {
+  char buf[96];
+  uint32_t len;
+} _mb_line_t;
+
+#define MB_RODATA __attribute__((section(".ulib.text.rodata")))
+
+MB_RODATA static const char mb_str_tag[] = "MEMBENCH";
+MB_RODATA static const char mb_str_copy[] = "copy";
+MB_RODATA static const char mb_str_scale[] = "scale";
+MB_RODATA static const char mb_str_add[] = "add";
+MB_RODATA static const char mb_str_triad[] = "triad";
+MB_RODATA static const char mb_str_chase[] = "chase";
+MB_RODATA static const char mb_str_pattern[] = "pattern";
+MB_RODATA static const char mb_str_word[] = "word";
+MB_RODATA static const char mb_str_ldm[] = "ldm";
+MB_RODATA static const char mb_str_neon[] = "neon";
+
+MB_RODATA static const char *const mb_variants[MEMBENCH_VARIANTS] = {
+    mb_str_word, mb_str_ldm, mb_str_neon};
+
+MB_RODATA static const _mb_stream_t mb_stream[] = {
+    {mb_str_copy, 2, {_mb_copy_word, _mb_copy_ldm, _mb_copy_neon}},
+    {mb_str_scale, 2, {_mb_scale_word, _mb_scale_ldm, _mb_scale_neon}},
+    {mb_str_add, 3, {_mb_add_word, _mb_add_ldm, _mb_add_neon}},
+    {mb_str_triad, 3, {_mb_triad_word, _mb_triad_ldm, _mb_triad_neon}},
+};
+
+MB_RODATA static const _mb_fill_t mb_fill[MEMBENCH_VARIANTS] = {
+    _mb_fill_word, _mb_fill_ldm, _mb_fill_neon};
+
+MB_RODATA static const uint32_t mb_patterns[] = {0x00000000, 0xFFFFFFFF,
+                                                 0x55AA55AA, 0xAA55AA55};
+
+#define MB_STREAM_TESTS (sizeof(mb_stream) / sizeof(mb_stream[0]))
+#define MB_PATTERNS (sizeof(mb_patterns) / sizeof(mb_patterns[0]))
+
+// Shift and subtract division, there is no hardware divider nor libgcc
+__attribute__((section(".ulib.text"))) static uint32_t mb_div(uint64_t num,
+                                                              uint32_t den) {
+  uint64_t quot = 0;
+  uint64_t rem = 0;
+
+  for (int32_t bit = 63; bit >= 0; bit--) {
+    rem = (rem << 1) | ((num >> bit) & 1);
+    if (rem >= den) {
+      rem -= den;
+      quot |= 1ull << bit;
+    }
+  }
+  return (uint32_t)quot;
+}
+
+__attribute__((section(".ulib.text"))) static void mb_puts(_mb_line_t *line,
+                                                           const char *s) {
+  while (*s && line->len < sizeof(line->buf) - 1) {
+    line->buf[line->len++] = *s++;
+  }
+}
+
+__attribute__((section(".ulib.text"))) static void mb_hex(_mb_line_t *line,
+                                                          uint32_t val) {
+  if (line->len + 11 > sizeof(line->buf) - 1) {
+    return;
+  }
+  line->buf[line->len++] = ' ';
+  line->buf[line->len++] = '0';
+  line->buf[line->len++] = 'x';
+  for (int32_t shift = 28; shift >= 0; shift -= 4) {
+    uint32_t digit = (val >> shift) & 0xF;
+    line->buf[line->len++] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+  }
+}
+
+// Blocks until the line is out, retrying while both DMA channels are busy
+__attribute__((section(".ulib.text"))) static void
+mb_flush(_mb_line_t *line) {
+  line->buf[line->len++] = '\n';
+  while ((int32_t)SYSCALL2(SYS_UART_WRITE, line->buf, line->len) ==
+         DMA_ERROR_BUSY) {
+  }
+  line->len = 0;
+}
+
+// MEMBENCH <task> <test> <variant> <size> <MB/s> <ns/access> <errors>
+// `bytes` were moved in `us` microseconds, a byte per microsecond is 1MB/s.
+__attribute__((section(".ulib.text"))) static void
+mb_report(const _membench_cfg_t *cfg, const char *test, uint32_t variant,
+          uint32_t size, uint64_t bytes, uint32_t accesses, uint32_t us,
+          uint32_t errors) {
+  _mb_line_t line;
+  line.len = 0;
+
+  mb_puts(&line, mb_str_tag);
+  line.buf[line.len++] = ' ';
+  mb_puts(&line, cfg->name);
+  line.buf[line.len++] = ' ';
+  mb_puts(&line, test);
+  line.buf[line.len++] = ' ';
+  mb_puts(&line, mb_variants[variant]);
+  mb_hex(&line, size);
+  mb_hex(&line, mb_div(bytes, us));
+  mb_hex(&line, mb_div((uint64_t)us * 1000, accesses));
+  mb_hex(&line, errors);
+  mb_flush(&line);
+}
+
+// Repetitions of a `bytes` long pass that make up MEMBENCH_MIN_BYTES
+__attribute__((section(".ulib.text"))) static uint32_t
+mb_passes(uint32_t bytes) {
+  uint32_t passes = 1;
+  while (passes * bytes < MEMBENCH_MIN_BYTES) {
+    passes <<= 1;
+  }
+  return passes;
+}
+
+__attribute__((section(".ulib.text"))) static uint32_t mb_now(void) {
+  return (uint32_t)clock_now_us();
+}
+
+// Never 0, it divides the results
+__attribute__((section(".ulib.text"))) static uint32_t mb_best(uint32_t best,
+                                                               uint32_t us) {
+  if (us == 0) {
+    us = 1;
+  }
+  return us < best ? us : best;
+}
+
+__attribute__((section(".ulib.text"))) static void
+mb_stream_run(const _membench_cfg_t *cfg, uint32_t *buf, uint32_t size) {
+  uint32_t words = size >> 2;
+  uint32_t *a = buf;
+  uint32_t *b = buf + words;
+  uint32_t *dst = buf + 2 * words;
+
+  // Also faults in the SYS_BRK pages before anything is timed
+  _mb_fill_word(a, 1, size);
+  _mb_fill_word(b, 2, size);
+  _mb_fill_word(dst, 0, size);
+
+  for (uint32_t test = 0; test < MB_STREAM_TESTS; test++) {
+    const _mb_stream_t *stream = &mb_stream[test];
+    uint32_t passes = mb_passes(size * stream->arrays);
+
+    for (uint32_t variant = 0; variant < MEMBENCH_VARIANTS; variant++) {
+      _mb_kernel_t fn = stream->fn[variant];
+      uint32_t best = 0xFFFFFFFF;
+
+      for (uint32_t run = 0; run < MEMBENCH_RUNS; run++) {
+        uint32_t start = mb_now();
+        for (uint32_t pass = 0; pass < passes; pass++) {
+          fn(dst, a, b, size);
+        }
+        best = mb_best(best, mb_now() - start);
+      }
+      uint32_t bytes = passes * size * stream->arrays;
+      mb_report(cfg, stream->name, variant, size, bytes, bytes >> 2, best, 0);
+    }
+  }
+}
+
+// Links the MEMBENCH_STRIDE apart elements of `buf` into one random cycle
+// (Sattolo's algorithm), so the loads defeat any prefetching.
+__attribute__((section(".ulib.text"))) static void
+mb_chase_init(uint32_t *buf, uint32_t elements) {
+  const uint32_t step = MEMBENCH_STRIDE >> 2;
+  uint32_t seed = 0x2545F491;
+
+  for (uint32_t i = 0; i < elements; i++) {
+    buf[i * step] = i;
+  }
+  for (uint32_t i = elements - 1; i > 0; i--) {
+    // xorshift32, scaled to [0, i) without a division
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    uint32_t j = (uint32_t)(((uint64_t)seed * i) >> 32);
+    uint32_t tmp = buf[i * step];
+    buf[i * step] = buf[j * step];
+    buf[j * step] = tmp;
+  }
+  // Element indices to addresses
+  for (uint32_t i = 0; i < elements; i++) {
+    buf[i * step] = (uint32_t)&buf[buf[i * step] * step];
+  }
+}
+
+__attribute__((section(".ulib.text"))) static void
+mb_chase_run(const _membench_cfg_t *cfg, uint32_t *buf, uint32_t size) {
+  uint32_t elements = size / MEMBENCH_STRIDE;
+  uint32_t loads = elements;
+  while (loads < MEMBENCH_MIN_LOADS) {
+    loads <<= 1;
+  }
+
+  mb_chase_init(buf, elements);
+  uint32_t best = 0xFFFFFFFF;
+  for (uint32_t run = 0; run < MEMBENCH_RUNS; run++) {
+    uint32_t start = mb_now();
+    _mb_chase(buf, loads);
+    best = mb_best(best, mb_now() - start);
+  }
+  mb_report(cfg, mb_str_chase, MEMBENCH_WORD, size, loads << 2, loads, best,
+            0);
+}
+
+// Only the fills are timed, the word by word check is not
+__attribute__((section(".ulib.text"))) static void
+mb_pattern_run(const _membench_cfg_t *cfg, uint32_t *buf, uint32_t size) {
+  uint32_t words = size >> 2;
+  uint32_t passes = mb_passes(size);
+
+  for (uint32_t variant = 0; variant < MEMBENCH_VARIANTS; variant++) {
+    _mb_fill_t fill = mb_fill[variant];
+    uint32_t best = 0xFFFFFFFF;
+    uint32_t errors = 0;
+
+    for (uint32_t run = 0; run < MEMBENCH_RUNS; run++) {
+      uint32_t pattern = mb_patterns[run % MB_PATTERNS];
+      uint32_t start = mb_now();
+      for (uint32_t pass = 0; pass < passes; pass++) {
+        fill(buf, pattern, size);
+      }
+      best = mb_best(best, mb_now() - start);
+
+      for (uint32_t i = 0; i < words; i++) {
+        if (buf[i] != pattern) {
+          errors++;
+        }
+      }
+    }
+    uint32_t bytes = passes * size;
+    mb_report(cfg, mb_str_pattern, variant, size, bytes, bytes >> 2, best,
+              errors);
+  }
+}
+
+__attribute__((section(".ulib.text"))) void
+membench_run(const _membench_cfg_t *cfg) {
+  for (uint32_t i = 0; i < cfg->size_count; i++) {
+    uint32_t size = cfg->sizes[i];
+    // The kernels work in 32 byte blocks, the chase in whole elements
+    if (size < MEMBENCH_MIN_SIZE || size > MEMBENCH_MAX_SIZE ||
+        (size & (size - 1)) != 0) {
+      continue;
+    }
+
+    uint32_t footprint = 3 * size;
+    uint32_t *buf = cfg->rarea;
+    uint32_t brk_base = 0;
+    if (footprint > cfg->rarea_size) {
+      brk_base = SYSCALL1(SYS_BRK, 0);
+      if (SYSCALL1(SYS_BRK, brk_base + footprint) != brk_base + footprint) {
+        continue;
+      }
+      buf = (uint32_t *)brk_base;
+    }
+
+    mb_stream_run(cfg, buf, size);
+    mb_chase_run(cfg, buf, size);
+    mb_pattern_run(cfg, buf, size);
+
+    // Gives the pages back to the pool
+    if (brk_base != 0) {
+      SYSCALL1(SYS_BRK, brk_base);
+    }
+  }
+}
@@ -1,7 +1,12 @@
 #include "inc/mmu.h"
 #include "../sys/inc/logger.h"
+#include "inc/board.h"
+#include "inc/clock.h"
+#include "inc/dma.h"
 #include "inc/gic.h"
+#include "inc/sched.h"
 #include "inc/timer.h"
+#include "inc/trace.h"
 #include "inc/uart.h"
 #include <stdio.h>
 #include <string.h>
@@ -34,23 +39,6 @@ __attribute__((section(".text"))) void copy_sections(void) {
                     GET_SYMBOL_VALUE(_KERNEL_DATA_SIZE));
   copy_lma_into_phy(&_KERNEL_RODATA_PHY, &_KERNEL_RODATA_LMA,
                     GET_SYMBOL_VALUE(_KERNEL_RODATA_SIZE));
-
-  copy_lma_into_phy(&_TASK0_TEXT_PHY, &_TASK0_TEXT_LMA,
-                    GET_SYMBOL_VALUE(_TASK0_TEXT_SIZE));
-
-  copy_lma_into_phy(&_TASK1_TEXT_PHY, &_TASK1_TEXT_LMA,
-                    GET_SYMBOL_VALUE(_TASK1_TEXT_SIZE));
-  copy_lma_into_phy(&_TASK1_DATA_PHY, &_TASK1_DATA_LMA,
-                    GET_SYMBOL_VALUE(_TASK1_DATA_SIZE));
-  copy_lma_into_phy(&_TASK1_RODATA_PHY, &_TASK1_RODATA_LMA,
-                    GET_SYMBOL_VALUE(_TASK1_RODATA_SIZE));
-
-  copy_lma_into_phy(&_TASK2_TEXT_PHY, &_TASK2_TEXT_LMA,
-                    GET_SYMBOL_VALUE(_TASK2_TEXT_SIZE));
-  copy_lma_into_phy(&_TASK2_DATA_PHY, &_TASK2_DATA_LMA,
-                    GET_SYMBOL_VALUE(_TASK2_DATA_SIZE));
-  copy_lma_into_phy(&_TASK2_RODATA_PHY, &_TASK2_RODATA_LMA,
-                    GET_SYMBOL_VALUE(_TASK2_RODATA_SIZE));
 }
 
 __attribute__((section(".kernel.text.mmu"))) void c_mmu_init(void) {
@@ -67,15 +55,16 @@ __attribute__((section(".kernel.text.mmu"))) void c_mmu_init(void) {
 }
 
 __attribute__((section(".kernel.text.mmu"))) void
-c_mmu_fill_tables(mmu_tables_t *tables, uint32_t task_id) {
+c_mmu_fill_tables(mmu_tables_t *tables) {
+  // The L2 tables are cleared as mmu_l2_table() hands them out
   clear_memory(tables->l1_table, L1_SIZE);
-  for (int i = 0; i < L2_TABLES_PER_TASK; i++) {
-    clear_memory(tables->l2_tables[i], L2_SIZE);
-  }
   tables->next_l2_table = 0;
 
-  c_log_mapping("Mapping RGN", 0x70010000, 0x70010000, 4 * 1024);
-  map_region(tables, 0x70010000, 0x70010000, 4 * 1024, L2_DEFAULT_FLAGS);
+  // Boot region (.text, .data, .bss). The exception handlers live here.
+  c_log_mapping("Boot region", (uint32_t)&_PUBLIC_RAM_INIT,
+                (uint32_t)&_PUBLIC_RAM_INIT, GET_SYMBOL_VALUE(_BOOT_SIZE));
+  map_region(tables, (uint32_t)&_PUBLIC_RAM_INIT, (uint32_t)&_PUBLIC_RAM_INIT,
+             GET_SYMBOL_VALUE(_BOOT_SIZE), L2_DEFAULT_FLAGS);
 
   c_log_mapping(".kernel.text", (uint32_t)&_KERNEL_TEXT_VMA,
                 (uint32_t)&_KERNEL_TEXT_PHY,
@@ -106,155 +95,57 @@ c_mmu_fill_tables(mmu_tables_t *tables, uint32_t task_id) {
   map_region(tables, (uint32_t)&_KERNEL_STACK, (uint32_t)&_KERNEL_STACK,
              GET_SYMBOL_VALUE(_KERNEL_STACK_SIZE), L2_DEFAULT_FLAGS);
 
+  c_log_mapping("Kernel heap", (uint32_t)&_KERNEL_HEAP_START,
+                (uint32_t)&_KERNEL_HEAP_START,
+                GET_SYMBOL_VALUE(_KERNEL_HEAP_SIZE));
+  map_region(tables, (uint32_t)&_KERNEL_HEAP_START,
+             (uint32_t)&_KERNEL_HEAP_START, GET_SYMBOL_VALUE(_KERNEL_HEAP_SIZE),
+             L2_DEFAULT_FLAGS);
+
   // MMU
-  c_log_mapping("MMU region", 0x70080000, 0x70080000, 32 * 3 * 1024);
-  map_region(tables, 0x70080000, 0x70080000, 32 * 3 * 1024, L2_DEFAULT_FLAGS);
+  c_log_mapping("MMU region", (uint32_t)&_MMU_INIT, (uint32_t)&_MMU_INIT,
+                MAX_TASKS * sizeof(mmu_tables_t));
+  map_region(tables, (uint32_t)&_MMU_INIT, (uint32_t)&_MMU_INIT,
+             MAX_TASKS * sizeof(mmu_tables_t), L2_DEFAULT_FLAGS);
 
   // Vector Table
   c_log_mapping("Vector Table", 0x00000000, 0x00000000, 4 * 1024);
   c_mmu_map_4kb_page(tables, 0x00000000, 0x00000000, L2_DEFAULT_FLAGS);
 
-  // Peripherals
-  c_log_mapping("GICC0", GICC0_ADDR, GICC0_ADDR, 4 * 1024);
-  c_mmu_map_4kb_page(tables, GICC0_ADDR, GICC0_ADDR, L2_DEFAULT_FLAGS);
-
-  c_log_mapping("GICD0", GICD0_ADDR, GICD0_ADDR, 4 * 1024);
-  c_mmu_map_4kb_page(tables, GICD0_ADDR, GICD0_ADDR, L2_DEFAULT_FLAGS);
-
-  c_log_mapping("UART0", UART0_ADDR, UART0_ADDR, 4 * 1024);
-  c_mmu_map_4kb_page(tables, UART0_ADDR, UART0_ADDR, L2_DEFAULT_FLAGS);
-
-  c_log_mapping("TIMER0", TIMER0_ADDR, TIMER0_ADDR, 4 * 1024);
-  c_mmu_map_4kb_page(tables, TIMER0_ADDR, TIMER0_ADDR, L2_DEFAULT_FLAGS);
-
-  switch (task_id) {
-  case 0:
-    c_log_mapping("TASK0 .text", (uint32_t)&_TASK0_TEXT_VMA,
-                  (uint32_t)&_TASK0_TEXT_PHY,
-                  GET_SYMBOL_VALUE(_TASK0_TEXT_SIZE));
-    map_region(tables, (uint32_t)&_TASK0_TEXT_VMA, (uint32_t)&_TASK0_TEXT_PHY,
-               GET_SYMBOL_VALUE(_TASK0_TEXT_SIZE), L2_DEFAULT_FLAGS);
-    break;
-
-  case 1:
-    // The stack is initialized at its physical address (_TASK1_STACK_PHY).
-    // Since the physical address differs from the virtual address (VMA),
-    // we copy the initial stack contents to _TASK1_STACK_PHY before enabling
-    // the MMU. After pagination, the MMU maps the virtual address
-    // (_TASK1_STACK) to the physical address (_TASK1_STACK_PHY), so all stack
-    // accesses in C code use the VMA, while the actual memory resides at the
-    // physical address.
-    copy_lma_into_phy(&_TASK1_STACK_PHY, &_TASK1_STACK,
-                      GET_SYMBOL_VALUE(_TASK1_STACK_SIZE));
-
-    c_log_mapping("TASK1 .text", (uint32_t)&_TASK1_TEXT_VMA,
-                  (uint32_t)&_TASK1_TEXT_PHY,
-                  GET_SYMBOL_VALUE(_TASK1_TEXT_SIZE));
-    map_region(tables, (uint32_t)&_TASK1_TEXT_VMA, (uint32_t)&_TASK1_TEXT_PHY,
-               GET_SYMBOL_VALUE(_TASK1_TEXT_SIZE), L2_USR_ROFLAGS);
-
-    c_log_mapping("TASK1 .data", (uint32_t)&_TASK1_DATA_VMA,
-                  (uint32_t)&_TASK1_DATA_PHY,
-                  GET_SYMBOL_VALUE(_TASK1_DATA_SIZE));
-    map_region(tables, (uint32_t)&_TASK1_DATA_VMA, (uint32_t)&_TASK1_DATA_PHY,
-               GET_SYMBOL_VALUE(_TASK1_DATA_SIZE), L2_USR_FLAGS);
-
-    c_log_mapping("TASK1 .rodata", (uint32_t)&_TASK1_RODATA_VMA,
-                  (uint32_t)&_TASK1_RODATA_PHY,
-                  GET_SYMBOL_VALUE(_TASK1_RODATA_SIZE));
-    map_region(tables, (uint32_t)&_TASK1_RODATA_VMA,
-               (uint32_t)&_TASK1_RODATA_PHY,
-               GET_SYMBOL_VALUE(_TASK1_RODATA_SIZE), L2_USR_ROFLAGS);
-
-    c_log_mapping("TASK1 .bss", (uint32_t)&_TASK1_BSS_VMA,
-                  (uint32_t)&_TASK1_BSS_PHY, GET_SYMBOL_VALUE(_TASK1_BSS_SIZE));
-    map_region(tables, (uint32_t)&_TASK1_BSS_VMA, (uint32_t)&_TASK1_BSS_PHY,
-               GET_SYMBOL_VALUE(_TASK1_BSS_SIZE), L2_USR_ROFLAGS);
-
-    c_log_mapping("TASK1 .stack", (uint32_t)&_TASK1_STACK,
-                  (uint32_t)&_TASK1_STACK_PHY,
-                  GET_SYMBOL_VALUE(_TASK1_STACK_SIZE));
-    map_region(tables, (uint32_t)&_TASK1_STACK, (uint32_t)&_TASK1_STACK_PHY,
-               GET_SYMBOL_VALUE(_TASK1_STACK_SIZE), L2_USR_FLAGS);
-
-    c_log_mapping("TASK1 RAREA", (uint32_t)&_TASK1_RAREA_START_VMA,
-                  (uint32_t)&_TASK1_RAREA_START_PHY, TASK1_RAREA_SIZE_B);
-    map_region(tables, (uint32_t)&_TASK1_RAREA_START_VMA,
-               (uint32_t)&_TASK1_RAREA_START_PHY, TASK1_RAREA_SIZE_B,
-               L2_USR_FLAGS);
-    break;
-
-  case 2:
-    // The stack is initialized at its physical address (_TASK2_STACK_PHY).
-    // Since the physical address differs from the virtual address (VMA),
-    // we copy the initial stack contents to _TASK2_STACK_PHY before enabling
-    // the MMU. After pagination, the MMU maps the virtual address
-    // (_TASK2_STACK) to the physical address (_TASK2_STACK_PHY), so all stack
-    // accesses in C code use the VMA, while the actual memory resides at the
-    // physical address.
-    copy_lma_into_phy(&_TASK2_STACK_PHY, &_TASK2_STACK,
-                      GET_SYMBOL_VALUE(_TASK2_STACK_SIZE));
-
-    c_log_mapping("TASK2 .text", (uint32_t)&_TASK2_TEXT_VMA,
-                  (uint32_t)&_TASK2_TEXT_PHY,
-                  GET_SYMBOL_VALUE(_TASK2_TEXT_SIZE));
-    map_region(tables, (uint32_t)&_TASK2_TEXT_VMA, (uint32_t)&_TASK2_TEXT_PHY,
-               GET_SYMBOL_VALUE(_TASK2_TEXT_SIZE), L2_USR_ROFLAGS);
-
-    c_log_mapping("TASK2 .data", (uint32_t)&_TASK2_DATA_VMA,
-                  (uint32_t)&_TASK2_DATA_PHY,
-                  GET_SYMBOL_VALUE(_TASK2_DATA_SIZE));
-    map_region(tables, (uint32_t)&_TASK2_DATA_VMA, (uint32_t)&_TASK2_DATA_PHY,
-               GET_SYMBOL_VALUE(_TASK2_DATA_SIZE), L2_USR_ROFLAGS);
-
-    c_log_mapping("TASK2 .rodata", (uint32_t)&_TASK2_RODATA_VMA,
-                  (uint32_t)&_TASK2_RODATA_PHY,
-                  GET_SYMBOL_VALUE(_TASK2_RODATA_SIZE));
-    map_region(tables, (uint32_t)&_TASK2_RODATA_VMA,
-               (uint32_t)&_TASK2_RODATA_PHY,
-               GET_SYMBOL_VALUE(_TASK2_RODATA_SIZE), L2_USR_FLAGS);
-
-    c_log_mapping("TASK2 .bss", (uint32_t)&_TASK2_BSS_VMA,
-                  (uint32_t)&_TASK2_BSS_PHY, GET_SYMBOL_VALUE(_TASK2_BSS_SIZE));
-    map_region(tables, (uint32_t)&_TASK2_BSS_VMA, (uint32_t)&_TASK2_BSS_PHY,
-               GET_SYMBOL_VALUE(_TASK2_BSS_SIZE), L2_USR_FLAGS);
-
-    c_log_mapping("TASK2 .stack", (uint32_t)&_TASK2_STACK,
-                  (uint32_t)&_TASK2_STACK_PHY,
-                  GET_SYMBOL_VALUE(_TASK2_STACK_SIZE));
-    map_region(tables, (uint32_t)&_TASK2_STACK, (uint32_t)&_TASK2_STACK_PHY,
-               GET_SYMBOL_VALUE(_TASK2_STACK_SIZE), L2_USR_FLAGS);
-
-    c_log_mapping("TASK2 RAREA", (uint32_t)&_TASK2_RAREA_START_VMA,
-                  (uint32_t)&_TASK2_RAREA_START_PHY, TASK2_RAREA_SIZE_B);
-    map_region(tables, (uint32_t)&_TASK2_RAREA_START_VMA,
-               (uint32_t)&_TASK2_RAREA_START_PHY, TASK2_RAREA_SIZE_B,
-               L2_USR_FLAGS);
-    break;
-
-  default:
-    break;
-  }
+  // Peripherals (kernel/inc/board.h)
+#define MMU_MAP_DEVICE(name, addr, flags)                                      \
+  c_log_mapping(name, addr, addr, 4 * 1024);                                   \
+  c_mmu_map_4kb_page(tables, addr, addr, flags);
+  BOARD_DEVICES(MMU_MAP_DEVICE)
+#undef MMU_MAP_DEVICE
 
-  c_log_info("Pagination Done");
+  c_log_mapping("Clock page", (uint32_t)&clock_page, (uint32_t)&clock_page,
+                4 * 1024);
+  c_mmu_map_4kb_page(tables, (uint32_t)&clock_page, (uint32_t)&clock_page,
+                     L2_KRN_RW_USR_RO_FLAGS);
+
+  c_log_info("Kernel pagination Done");
 }
 
-__attribute__((section(".kernel.text.mmu"))) int32_t
-c_mmu_map_4kb_page(mmu_tables_t *tables, uint32_t virt_addr, uint32_t phys_addr,
-                   uint32_t l2_flags) {
+// Returns the L2 table covering virt_addr, allocating it if `alloc` is set,
+// or NULL.
+__attribute__((section(".kernel.text.mmu"))) static uint32_t *
+mmu_l2_table(mmu_tables_t *tables, uint32_t virt_addr, uint32_t alloc,
+             uint32_t log) {
   uint32_t l1_index = virt_addr >> 20;
-  if (l1_index >= L1_ENTRIES)
-    return ERROR_L1_INDEX_OOR;
 
-  uint32_t *l2_table;
-  // Allocate an L2 table if not present
-  if ((tables->l1_table[l1_index] & 0x3) == 0) {
-    if (tables->next_l2_table >= L2_TABLES_PER_TASK)
-      return ERROR_L2_INDEX_OOR;
-    l2_table = tables->l2_tables[tables->next_l2_table++];
-    clear_memory(l2_table, L2_SIZE);
-    tables->l1_table[l1_index] =
-        ((uintptr_t)l2_table & 0xFFFFFC00) | L1_TYPE_COARSE_TABLE;
+  if ((tables->l1_table[l1_index] & 0x3) != 0) {
+    return (uint32_t *)(tables->l1_table[l1_index] & 0xFFFFFC00);
+  }
+  if (!alloc || tables->next_l2_table >= L2_TABLES_PER_TASK) {
+    return NULL;
+  }
+
+  uint32_t *l2_table = tables->l2_tables[tables->next_l2_table++];
+  clear_memory(l2_table, L2_SIZE);
+  tables->l1_table[l1_index] =
+      ((uintptr_t)l2_table & 0xFFFFFC00) | L1_TYPE_COARSE_TABLE;
+  if (log) {
     c_puts("[MMU] New L2 table for VA range: ");
     c_puts_hex(l1_index << 20);
     c_puts(" - ");
@@ -262,13 +153,19 @@ c_mmu_map_4kb_page(mmu_tables_t *tables, uint32_t virt_addr, uint32_t phys_addr,
     c_puts(" -> L2 table at PA: ");
     c_puts_hex((uint32_t)l2_table);
     c_putsln("");
-  } else {
-    l2_table = (uint32_t *)(tables->l1_table[l1_index] & 0xFFFFFC00);
   }
+  return l2_table;
+}
 
-  uint32_t l2_index = (virt_addr >> 12) & 0xFF;
-  if (l2_index >= L2_ENTRIES)
+__attribute__((section(".kernel.text.mmu"))) int32_t
+c_mmu_map_4kb_page(mmu_tables_t *tables, uint32_t virt_addr, uint32_t phys_addr,
+                   uint32_t l2_flags) {
+  // Allocate an L2 table if not present
+  uint32_t *l2_table = mmu_l2_table(tables, virt_addr, 1, 1);
+  if (l2_table == NULL)
     return ERROR_L2_INDEX_OOR;
+
+  uint32_t l2_index = (virt_addr >> 12) & 0xFF;
   if (l2_table[l2_index] != 0)
     return ERROR_L2_IN_USE;
 
@@ -277,9 +174,138 @@ c_mmu_map_4kb_page(mmu_tables_t *tables, uint32_t virt_addr, uint32_t phys_addr,
   return PAGING_SUCCESS;
 }
 
+__attribute__((section(".kernel.text.mmu"))) uint32_t *
+c_mmu_l2_entry(mmu_tables_t *tables, uint32_t virt_addr) {
+  uint32_t *l2_table = mmu_l2_table(tables, virt_addr, 0, 0);
+  if (l2_table == NULL) {
+    return NULL;
+  }
+  return &l2_table[(virt_addr >> 12) & 0xFF];
+}
+
+__attribute__((section(".kernel.text.mmu"))) static uint32_t
+mmu_tables_active(mmu_tables_t *tables) {
+  uint32_t ttbr0;
+  asm volatile("mrc p15, 0, %0, c2, c0, 0" : "=r"(ttbr0));
+  return (ttbr0 & ~(L1_ALIGN - 1)) == (uint32_t)tables->l1_table;
+}
+
+// Makes descriptor changes on [virt_addr, virt_addr + pages) visible: one
+// barrier, then the TLB maintenance if the tables are in use.
+__attribute__((section(".kernel.text.mmu"))) static void
+mmu_sync_range(mmu_tables_t *tables, uint32_t virt_addr, uint32_t pages) {
+  asm volatile("dsb" ::: "memory");
+  if (!mmu_tables_active(tables)) {
+    return;
+  }
+  if (pages > MMU_TLB_RANGE_PAGES) {
+    mmu_tlb_flush_all();
+    return;
+  }
+  for (uint32_t i = 0; i < pages; i++) {
+    // TLBIMVA, ASID 0
+    asm volatile("mcr p15, 0, %0, c8, c7, 1" ::"r"((virt_addr & 0xFFFFF000) +
+                                                   (i << 12)));
+  }
+  asm volatile("dsb\n\tisb" ::: "memory");
+}
+
+// Maps every range of `maps`. Like c_mmu_map_4kb_page() it does not replace
+// existing entries. On failure the pages mapped by this call are unmapped
+// again. The entries were faulting before, so only a barrier is needed.
+__attribute__((section(".kernel.text.mmu"))) int32_t
+c_mmu_map_batch(mmu_tables_t *tables, const _mmu_map_t *maps,
+                uint32_t count) {
+  int32_t ret = PAGING_SUCCESS;
+  uint32_t done = 0; // Pages of maps[i] mapped so far
+  uint32_t i;
+
+  for (i = 0; i < count && ret == PAGING_SUCCESS; i++) {
+    uint32_t pages = (maps[i].size + 0xFFF) >> 12;
+    uint32_t *l2_table = NULL;
+    for (done = 0; done < pages; done++) {
+      uint32_t va = maps[i].va + (done << 12);
+      if (l2_table == NULL || (va & 0xFFFFF) == 0) {
+        l2_table = mmu_l2_table(tables, va, 1, 0);
+        if (l2_table == NULL) {
+          ret = ERROR_L2_INDEX_OOR;
+          break;
+        }
+      }
+      uint32_t *entry = &l2_table[(va >> 12) & 0xFF];
+      if (*entry != 0) {
+        ret = ERROR_L2_IN_USE;
+        break;
+      }
+      *entry = ((maps[i].pa + (done << 12)) & 0xFFFFF000) | maps[i].flags;
+    }
+  }
+
+  if (ret != PAGING_SUCCESS) {
+    // maps[i - 1] failed after `done` pages, the ones before are complete
+    c_mmu_unmap_range(tables, maps[i - 1].va, done << 12, NULL);
+    for (uint32_t j = 0; j + 1 < i; j++) {
+      c_mmu_unmap_range(tables, maps[j].va, maps[j].size, NULL);
+    }
+    return ret;
+  }
+  asm volatile("dsb\n\tisb" ::: "memory");
+  return PAGING_SUCCESS;
+}
+
+// Clears the entries of the range, unmapped pages are skipped. `release` is
+// called before the TLB maintenance, it must not hand the page out again
+// before this returns (the system calls run with IRQs masked).
+__attribute__((section(".kernel.text.mmu"))) int32_t
+c_mmu_unmap_range(mmu_tables_t *tables, uint32_t virt_addr,
+                  uint32_t size_in_bytes, void (*release)(uint32_t)) {
+  uint32_t pages = (size_in_bytes + 0xFFF) >> 12;
+
+  for (uint32_t i = 0; i < pages; i++) {
+    uint32_t va = virt_addr + (i << 12);
+    uint32_t *l2_table = mmu_l2_table(tables, va, 0, 0);
+    if (l2_table == NULL) {
+      continue;
+    }
+    uint32_t *entry = &l2_table[(va >> 12) & 0xFF];
+    if (*entry == 0) {
+      continue;
+    }
+    if (release != NULL) {
+      release(*entry & 0xFFFFF000);
+    }
+    *entry = 0;
+  }
+  mmu_sync_range(tables, virt_addr, pages);
+  return PAGING_SUCCESS;
+}
+
+// Rewrites the permissions of the mapped pages of the range, keeping their
+// physical addresses.
+__attribute__((section(".kernel.text.mmu"))) int32_t
+c_mmu_protect_range(mmu_tables_t *tables, uint32_t virt_addr,
+                    uint32_t size_in_bytes, uint32_t l2_flags) {
+  uint32_t pages = (size_in_bytes + 0xFFF) >> 12;
+
+  for (uint32_t i = 0; i < pages; i++) {
+    uint32_t va = virt_addr + (i << 12);
+    uint32_t *l2_table = mmu_l2_table(tables, va, 0, 0);
+    if (l2_table == NULL) {
+      continue;
+    }
+    uint32_t *entry = &l2_table[(va >> 12) & 0xFF];
+    if (*entry != 0) {
+      *entry = (*entry & 0xFFFFF000) | l2_flags;
+    }
+  }
+  mmu_sync_range(tables, virt_addr, pages);
+  return PAGING_SUCCESS;
+}
+
 __attribute__((section(".kernel.text.mmu"))) int32_t
 map_region(mmu_tables_t *tables, uint32_t virt_addr, uint32_t phys_addr,
            uint32_t size_in_bytes, uint32_t l2_flags) {
+  TRACEPOINT_ARG(TRACE_MAP_REGION, virt_addr);
   uint32_t pages = (size_in_bytes + 0xFFF) / 0x1000;
   for (uint32_t i = 0; i < pages; i++) {
     uint32_t va = virt_addr + i * 0x1000;
@@ -0,0 +1,240 @@
+#include "inc/page.h"
+#include "../sys/inc/logger.h"
+#include "inc/irq.h"
+#include "inc/mmu.h"
+#include "inc/sched.h"
+#include <stddef.h>
+
+extern mmu_tables_t mmu_tables[MAX_TASKS];
+
+_page_zone_t page_zone_kernel;
+_page_zone_t page_zone_user;
+_page_zero_pool_t page_zero_pool;
+
+static inline uint32_t page_is_used(_page_zone_t *zone, uint32_t page) {
+  return zone->bitmap[page >> 5] & (1u << (page & 31));
+}
+
+static inline void page_set(_page_zone_t *zone, uint32_t first,
+                            uint32_t count, uint32_t used) {
+  for (uint32_t page = first; page < first + count; page++) {
+    if (used) {
+      zone->bitmap[page >> 5] |= 1u << (page & 31);
+      zone->refs[page] = 1;
+    } else {
+      zone->bitmap[page >> 5] &= ~(1u << (page & 31));
+      zone->refs[page] = 0;
+    }
+  }
+}
+
+static void page_zone_init(_page_zone_t *zone, const char *name,
+                           uintptr_t base, uint32_t size) {
+  zone->name = name;
+  zone->base = base;
+  zone->total = size >> PAGE_SHIFT;
+  if (zone->total > PAGE_ZONE_MAX_PAGES) {
+    zone->total = PAGE_ZONE_MAX_PAGES;
+  }
+  zone->used = 0;
+  zone->failures = 0;
+  for (uint32_t i = 0; i < PAGE_ZONE_MAX_PAGES / 32; i++) {
+    zone->bitmap[i] = 0;
+  }
+  for (uint32_t i = 0; i < PAGE_ZONE_MAX_PAGES; i++) {
+    zone->refs[i] = 0;
+  }
+}
+
+__attribute__((section(".kernel.text"))) void c_page_init(void) {
+  page_zone_init(&page_zone_kernel, "kernel",
+                 (uintptr_t)&_KERNEL_HEAP_START,
+                 GET_SYMBOL_VALUE(_KERNEL_HEAP_SIZE));
+  page_zone_init(&page_zone_user, "user", (uintptr_t)&_USER_POOL_START,
+                 GET_SYMBOL_VALUE(_USER_POOL_SIZE));
+  page_zero_pool.head = 0;
+  page_zero_pool.count = 0;
+  page_zero_pool.hits = 0;
+  page_zero_pool.misses = 0;
+}
+
+// First fit, with IRQs masked. Returns 0 when no run is long enough.
+static inline uintptr_t page_zone_take(_page_zone_t *zone, uint32_t count) {
+  uint32_t run = 0;
+
+  for (uint32_t page = 0; count != 0 && page < zone->total; page++) {
+    if (page_is_used(zone, page)) {
+      run = 0;
+      continue;
+    }
+    if (++run == count) {
+      uint32_t first = page + 1 - count;
+      page_set(zone, first, count, 1);
+      zone->used += count;
+      return zone->base + (first << PAGE_SHIFT);
+    }
+  }
+  return 0;
+}
+
+// Oldest page of the zero pool, with IRQs masked
+static inline uint32_t page_zero_pop(void) {
+  if (page_zero_pool.count == 0) {
+    return 0;
+  }
+  uint32_t page = page_zero_pool.pages[page_zero_pool.head];
+  page_zero_pool.head = (page_zero_pool.head + 1) % PAGE_ZERO_POOL;
+  page_zero_pool.count--;
+  return page;
+}
+
+__attribute__((section(".kernel.text"))) void *
+c_page_zone_alloc(_page_zone_t *zone, uint32_t count) {
+  uint32_t cpsr = irq_save();
+  uintptr_t addr = page_zone_take(zone, count);
+
+  // The last free user pages may be waiting in the zero pool
+  if (addr == 0 && zone == &page_zone_user && count == 1) {
+    addr = page_zero_pop();
+  }
+  if (addr != 0) {
+    irq_restore(cpsr);
+    return (void *)addr;
+  }
+  zone->failures++;
+  irq_restore(cpsr);
+  c_log_warn("Out of pages");
+  return NULL;
+}
+
+__attribute__((section(".kernel.text"))) void
+c_page_zone_free(_page_zone_t *zone, void *addr, uint32_t count) {
+  uint32_t first = ((uintptr_t)addr - zone->base) >> PAGE_SHIFT;
+
+  if ((uintptr_t)addr < zone->base || first + count > zone->total) {
+    c_log_error("Freeing pages outside of the zone");
+    return;
+  }
+  uint32_t cpsr = irq_save();
+  page_set(zone, first, count, 0);
+  zone->used -= count;
+  irq_restore(cpsr);
+}
+
+// Index of the used page holding addr, or zone->total
+static inline uint32_t page_index(_page_zone_t *zone, uint32_t addr) {
+  uint32_t page = (addr - zone->base) >> PAGE_SHIFT;
+  if (addr < zone->base || page >= zone->total || !page_is_used(zone, page)) {
+    return zone->total;
+  }
+  return page;
+}
+
+__attribute__((section(".kernel.text"))) void c_page_ref(_page_zone_t *zone,
+                                                         uint32_t addr) {
+  uint32_t cpsr = irq_save();
+  uint32_t page = page_index(zone, addr);
+  if (page < zone->total && zone->refs[page] < 0xFF) {
+    zone->refs[page]++;
+  }
+  irq_restore(cpsr);
+}
+
+__attribute__((section(".kernel.text"))) void c_page_unref(_page_zone_t *zone,
+                                                           uint32_t addr) {
+  uint32_t cpsr = irq_save();
+  uint32_t page = page_index(zone, addr);
+  if (page < zone->total && --zone->refs[page] == 0) {
+    page_set(zone, page, 1, 0);
+    zone->used--;
+  }
+  irq_restore(cpsr);
+}
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_page_refs(_page_zone_t *zone, uint32_t addr) {
+  uint32_t page = page_index(zone, addr);
+  return page < zone->total ? zone->refs[page] : 0;
+}
+
+__attribute__((section(".kernel.text"))) void *c_page_alloc(uint32_t count) {
+  return c_page_zone_alloc(&page_zone_kernel, count);
+}
+
+__attribute__((section(".kernel.text"))) void c_page_free(void *addr,
+                                                          uint32_t count) {
+  c_page_zone_free(&page_zone_kernel, addr, count);
+}
+
+__attribute__((section(".kernel.text"))) uint32_t c_page_zero_get(void) {
+  uint32_t cpsr = irq_save();
+  uint32_t page = page_zero_pop();
+  if (page != 0) {
+    page_zero_pool.hits++;
+  } else {
+    page_zero_pool.misses++;
+  }
+  irq_restore(cpsr);
+  return page;
+}
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_page_user_available(void) {
+  uint32_t cpsr = irq_save();
+  uint32_t free =
+      page_zone_user.total - page_zone_user.used + page_zero_pool.count;
+  irq_restore(cpsr);
+  return free;
+}
+
+// Points the PAGE_ZERO_VA window of the running task's tables at `page`.
+// Only the idle task uses the window, the first call allocates its L2 table.
+__attribute__((section(".kernel.text"))) static int32_t
+page_zero_window(uint32_t page) {
+  mmu_tables_t *tables = &mmu_tables[c_task_current()->id];
+  uint32_t *entry = c_mmu_l2_entry(tables, PAGE_ZERO_VA);
+
+  // The batch ends with the barriers, the page is cleared right after
+  if (entry == NULL) {
+    _mmu_map_t map;
+    map.va = PAGE_ZERO_VA;
+    map.pa = page;
+    map.size = PAGE_SIZE;
+    map.flags = L2_DEFAULT_FLAGS | L2_XN;
+    return c_mmu_map_batch(tables, &map, 1);
+  }
+  *entry = page | L2_DEFAULT_FLAGS | L2_XN;
+  // TLBIMVA, ASID 0
+  asm volatile("dsb\n\t"
+               "mcr p15, 0, %0, c8, c7, 1\n\t"
+               "dsb\n\t"
+               "isb" ::"r"(PAGE_ZERO_VA)
+               : "memory");
+  return PAGING_SUCCESS;
+}
+
+__attribute__((section(".kernel.text"))) void c_page_zero_refill(void) {
+  while (page_zero_pool.count < PAGE_ZERO_POOL) {
+    uint32_t cpsr = irq_save();
+    uint32_t page = page_zone_take(&page_zone_user, 1);
+    irq_restore(cpsr);
+    if (page == 0) {
+      return;
+    }
+
+    // The page is out of the zone and not in the pool yet, so clearing it
+    // can be preempted
+    if (page_zero_window(page) != PAGING_SUCCESS) {
+      c_page_zone_free(&page_zone_user, (void *)page, 1);
+      return;
+    }
+    clear_memory((void *)PAGE_ZERO_VA, PAGE_SIZE);
+
+    cpsr = irq_save();
+    uint32_t tail = (page_zero_pool.head + page_zero_pool.count) %
+                    PAGE_ZERO_POOL;
+    page_zero_pool.pages[tail] = page;
+    page_zero_pool.count++;
+    irq_restore(cpsr);
+  }
+}
@@ -0,0 +1,103 @@
+#include "inc/prof.h"
+#include "../sys/inc/logger.h"
+#include "inc/semihost.h"
+#include "inc/uart.h"
+
+#ifdef CONFIG_PROF
+static _prof_hist_t prof_hist[MAX_TASKS];
+static uint32_t prof_tasks = 0;
+
+// Histograms cover the first executable segment of the image.
+__attribute__((section(".kernel.text"))) void
+c_prof_task_init(_task_id_t id, const _task_image_t *image) {
+  _prof_hist_t *hist = &prof_hist[id];
+  uint32_t size = 0;
+
+  for (uint32_t i = 0; i < image->segment_count; i++) {
+    if (image->segments[i].flags & SEG_EXEC) {
+      hist->base = image->segments[i].vma;
+      size = image->segments[i].size;
+      break;
+    }
+  }
+  hist->shift = PROF_MIN_SHIFT;
+  while ((PROF_BUCKETS << hist->shift) < size) {
+    hist->shift++;
+  }
+  if (id >= prof_tasks) {
+    prof_tasks = id + 1;
+  }
+}
+
+// Called from the timer IRQ with the interrupted PC (ctx->lr)
+__attribute__((section(".kernel.text"))) void c_prof_sample(_task_id_t id,
+                                                            uint32_t pc) {
+  _prof_hist_t *hist = &prof_hist[id];
+  uint32_t bucket = (pc - hist->base) >> hist->shift;
+
+  hist->samples++;
+  if (pc < hist->base || bucket >= PROF_BUCKETS) {
+    hist->other++;
+    return;
+  }
+  hist->buckets[bucket]++;
+}
+
+static void prof_put_u32(uint32_t val) {
+  for (int i = 0; i < 4; i++) {
+    c_putchar((char)(val & 0xFF));
+    val >>= 8;
+  }
+}
+
+#ifdef CONFIG_SEMIHOST
+// Same dump, written in one go to PROF_HOST_FILE. The fields of _prof_hist_t
+// are in dump order.
+static int32_t prof_dump_host(void) {
+  int32_t handle = c_semihost_open(PROF_HOST_FILE, SEMIHOST_OPEN_WB);
+  if (handle < 0) {
+    return -1;
+  }
+
+  uint32_t header[4];
+  header[0] = PROF_MAGIC;
+  header[1] = PROF_VERSION;
+  header[2] = prof_tasks;
+  header[3] = PROF_BUCKETS;
+  c_semihost_write(handle, header, sizeof(header));
+  for (uint32_t id = 0; id < prof_tasks; id++) {
+    c_semihost_write(handle, &id, sizeof(id));
+    c_semihost_write(handle, &prof_hist[id], sizeof(_prof_hist_t));
+  }
+  return c_semihost_close(handle);
+}
+#endif
+
+// Raw binary dump over UART0, parsed by tools/prof_symbolize.py
+__attribute__((section(".kernel.text"))) void c_prof_dump(void) {
+#ifdef CONFIG_SEMIHOST
+  if (prof_dump_host() == 0) {
+    return;
+  }
+#endif
+  prof_put_u32(PROF_MAGIC);
+  prof_put_u32(PROF_VERSION);
+  prof_put_u32(prof_tasks);
+  prof_put_u32(PROF_BUCKETS);
+  for (uint32_t id = 0; id < prof_tasks; id++) {
+    _prof_hist_t *hist = &prof_hist[id];
+    prof_put_u32(id);
+    prof_put_u32(hist->base);
+    prof_put_u32(hist->shift);
+    prof_put_u32(hist->samples);
+    prof_put_u32(hist->other);
+    for (uint32_t i = 0; i < PROF_BUCKETS; i++) {
+      prof_put_u32(hist->buckets[i]);
+    }
+  }
+}
+#else
+__attribute__((section(".kernel.text"))) void c_prof_dump(void) {
+  c_log_warn("Profiler not built, use PROF=1");
+}
+#endif
@@ -0,0 +1,11 @@
+// board.rs
+
+// Mirror of kernel/inc/board_realview.h, the only board the Rust drivers
+// support (the Makefile refuses RS=1 with any other BOARD)
+
+pub const GICC0_ADDR: u32 = 0x1E000000;
+pub const GICD0_ADDR: u32 = 0x1E001000;
+pub const UART0_ADDR: u32 = 0x10009000;
+
+pub const GIC_SOURCE_TICK: u32 = 36;
+pub const GIC_SOURCE_UART0: u32 = 44;
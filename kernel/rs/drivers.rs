@@ -1,6 +1,8 @@
 #![no_std]
 #![no_main]
 
+mod board;
+mod executor;
 mod gic;
 mod uart;
 
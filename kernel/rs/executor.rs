@@ -0,0 +1,148 @@
+// executor.rs
+
+// Interrupt-aware async executor
+// Futures live in MAX_FUTURES static slots, there is no heap: spawn() takes
+// a &'static mut future, usually a `static mut` of the caller. A slot is
+// polled when its bit is set in READY. Its waker sets that bit, and a future
+// waiting on a device calls wait_irq() before returning Pending, so the next
+// interrupt of that GIC source (rs_irq_wake() from c_irq_handler) sets it.
+// run() sleeps in wfi while nothing is ready.
+
+#![allow(dead_code)]
+
+use core::arch::asm;
+use core::cell::UnsafeCell;
+use core::future::Future;
+use core::pin::Pin;
+use core::sync::atomic::{AtomicU32, Ordering};
+use core::task::{Context, Poll, RawWaker, RawWakerVTable, Waker};
+
+pub const MAX_FUTURES: usize = 8;
+// GIC interrupt lines, the ISENABLER[3] of gic.rs
+const GIC_LINES: usize = 96;
+const NO_SLOT: u32 = u32::MAX;
+
+type Slot = Option<Pin<&'static mut (dyn Future<Output = ()> + 'static)>>;
+
+// Only touched by spawn() and run(), never from IRQ context
+struct Slots(UnsafeCell<[Slot; MAX_FUTURES]>);
+unsafe impl Sync for Slots {}
+
+const EMPTY: Slot = None;
+static SLOTS: Slots = Slots(UnsafeCell::new([EMPTY; MAX_FUTURES]));
+// Bit n: slot n has to be polled
+static READY: AtomicU32 = AtomicU32::new(0);
+// Bit n of IRQ_WAITERS[id]: slot n waits for the GIC source id
+const NO_WAITERS: AtomicU32 = AtomicU32::new(0);
+static IRQ_WAITERS: [AtomicU32; GIC_LINES] = [NO_WAITERS; GIC_LINES];
+// Slot being polled
+static CURRENT: AtomicU32 = AtomicU32::new(NO_SLOT);
+
+// The waker data is the slot number
+unsafe fn waker_clone(data: *const ()) -> RawWaker {
+    RawWaker::new(data, &WAKER_VTABLE)
+}
+
+unsafe fn waker_wake(data: *const ()) {
+    READY.fetch_or(1 << (data as usize), Ordering::Release);
+}
+
+unsafe fn waker_drop(_data: *const ()) {}
+
+static WAKER_VTABLE: RawWakerVTable =
+    RawWakerVTable::new(waker_clone, waker_wake, waker_wake, waker_drop);
+
+fn waker(slot: usize) -> Waker {
+    unsafe { Waker::from_raw(RawWaker::new(slot as *const (), &WAKER_VTABLE)) }
+}
+
+// Runs `f` with IRQs masked
+pub fn critical<R>(f: impl FnOnce() -> R) -> R {
+    let cpsr: u32;
+    unsafe {
+        asm!("mrs {}, cpsr", "cpsid i", out(reg) cpsr);
+    }
+    let ret = f();
+    unsafe {
+        asm!("msr cpsr_c, {}", in(reg) cpsr);
+    }
+    ret
+}
+
+// Returns the slot, None when all of them are taken. Not callable from a
+// future being polled.
+pub fn spawn(future: &'static mut (dyn Future<Output = ()> + 'static)) -> Option<usize> {
+    let slots = unsafe { &mut *SLOTS.0.get() };
+    for (i, slot) in slots.iter_mut().enumerate() {
+        if slot.is_none() {
+            *slot = Some(unsafe { Pin::new_unchecked(future) });
+            READY.fetch_or(1 << i, Ordering::Release);
+            return Some(i);
+        }
+    }
+    None
+}
+
+// Called by a future of this executor before it returns Pending: the next
+// interrupt of the GIC source `id` polls it again.
+pub fn wait_irq(id: u32) {
+    let slot = CURRENT.load(Ordering::Relaxed);
+    if slot != NO_SLOT && (id as usize) < GIC_LINES {
+        IRQ_WAITERS[id as usize].fetch_or(1 << slot, Ordering::Release);
+    }
+}
+
+// Polls the spawned futures until all of them are done. It has to be
+// called with IRQs enabled, or a future waiting on wait_irq() never runs
+// again.
+pub fn run() {
+    let slots = unsafe { &mut *SLOTS.0.get() };
+    loop {
+        let ready = READY.swap(0, Ordering::Acquire);
+        if ready == 0 {
+            if slots.iter().all(|slot| slot.is_none()) {
+                return;
+            }
+            // A wake between the check and wfi leaves its IRQ pending, and
+            // wfi returns right away
+            critical(|| {
+                if READY.load(Ordering::Acquire) == 0 {
+                    unsafe { asm!("wfi") };
+                }
+            });
+            continue;
+        }
+
+        for (i, slot) in slots.iter_mut().enumerate() {
+            if ready & (1 << i) == 0 {
+                continue;
+            }
+            if let Some(future) = slot.as_mut() {
+                let waker = waker(i);
+                let mut cx = Context::from_waker(&waker);
+                CURRENT.store(i as u32, Ordering::Relaxed);
+                if future.as_mut().poll(&mut cx) == Poll::Ready(()) {
+                    *slot = None;
+                }
+                CURRENT.store(NO_SLOT, Ordering::Relaxed);
+            }
+        }
+    }
+}
+
+// Called by c_irq_handler() (or a driver's handler) once the device has been
+// acknowledged: the futures waiting on `id` are polled again.
+#[no_mangle]
+#[link_section = ".text"]
+pub extern "C" fn rs_irq_wake(id: u32) {
+    if (id as usize) < GIC_LINES {
+        let waiters = IRQ_WAITERS[id as usize].swap(0, Ordering::Acquire);
+        READY.fetch_or(waiters, Ordering::Release);
+    }
+}
+
+#[no_mangle]
+#[link_section = ".text"]
+pub extern "C" fn rs_executor_run() {
+    run();
+}
@@ -1,7 +1,6 @@
 // gic.rs
 
-const GICC0_ADDR: u32 = 0x1E000000;
-const GICD0_ADDR: u32 = 0x1E001000;
+use crate::board::{GICC0_ADDR, GICD0_ADDR, GIC_SOURCE_TICK, GIC_SOURCE_UART0};
 
 #[allow(non_snake_case)]
 #[repr(C)]
@@ -48,8 +47,8 @@ pub unsafe extern "C" fn rs_gic_init() {
     let gicd0 = &mut *(GICD0_ADDR as *mut GICD);
 
     gicc0.PMR = 0x000000F0;
-    gicd0.ISENABLER[1] |= 0x00000010;
-    gicd0.ISENABLER[1] |= 0x00001000;
+    gicd0.ISENABLER[(GIC_SOURCE_TICK >> 5) as usize] |= 1 << (GIC_SOURCE_TICK & 31);
+    gicd0.ISENABLER[(GIC_SOURCE_UART0 >> 5) as usize] |= 1 << (GIC_SOURCE_UART0 & 31);
     gicc0.CTLR = 0x00000001;
     gicd0.CTLR = 0x00000001;
 }
@@ -2,13 +2,22 @@
 
 #![allow(dead_code)]
 
-const UART0_ADDR: u32 = 0x10009000;
+use crate::board::{GIC_SOURCE_UART0, UART0_ADDR};
+use crate::executor;
+use core::future::Future;
+use core::pin::Pin;
+use core::ptr::{addr_of, addr_of_mut, read_volatile, write_volatile};
+use core::task::{Context, Poll};
 
 const FR_BUSY: u32 = 1 << 3;
 const LCRH_FEN: u32 = 1 << 4;
 const CR_UARTEN: u32 = 1 << 0;
 const FR_RXFE: u32 = 1 << 4;
 const FR_TXFF: u32 = 1 << 5;
+// Interrupt bits of IMSC, MIS and ICR
+const INT_RX: u32 = 1 << 4;
+const INT_TX: u32 = 1 << 5;
+const INT_RT: u32 = 1 << 6;
 
 #[allow(non_snake_case)]
 #[repr(C)]
@@ -23,6 +32,11 @@ struct UART {
     FBRD: u32,
     LCRH: u32,
     CR: u32,
+    IFLS: u32,
+    IMSC: u32,
+    RIS: u32,
+    MIS: u32,
+    ICR: u32,
 }
 
 #[no_mangle]
@@ -98,9 +112,165 @@ pub unsafe extern "C" fn rs_puts_hex(r: u32) {
         }
     }
 
-    rs_putchar("0x0");
+    rs_putchar(b'0');
+    rs_putchar(b'x');
     while i > 0 {
         i -= 1;
         rs_putchar(buffer[i]);
     }
 }
+
+// Async UART
+// The futures below move as many bytes as the FIFOs allow on each poll.
+// When the TX FIFO is full (or the RX FIFO empty) they unmask the matching
+// UART interrupt and wait for GIC_SOURCE_UART0 instead of spinning on FR,
+// so the executor runs its other futures meanwhile. rs_uart_irq() masks the
+// raised interrupts again and wakes them.
+
+fn uart0() -> *mut UART {
+    UART0_ADDR as *mut UART
+}
+
+fn uart_fr() -> u32 {
+    unsafe { read_volatile(addr_of!((*uart0()).FR)) }
+}
+
+// Read-modify-write of IMSC, also done by rs_uart_irq()
+fn uart_unmask(bits: u32) {
+    executor::critical(|| unsafe {
+        let imsc = addr_of_mut!((*uart0()).IMSC);
+        write_volatile(imsc, read_volatile(imsc) | bits);
+    });
+}
+
+pub struct UartWrite<'a> {
+    buf: &'a [u8],
+    pos: usize,
+}
+
+// Resolves to the number of bytes written, all of `buf`
+pub fn write(buf: &[u8]) -> UartWrite<'_> {
+    UartWrite { buf, pos: 0 }
+}
+
+impl Future for UartWrite<'_> {
+    type Output = usize;
+
+    fn poll(mut self: Pin<&mut Self>, _cx: &mut Context<'_>) -> Poll<usize> {
+        while self.pos < self.buf.len() {
+            if uart_fr() & FR_TXFF != 0 {
+                // Registered before unmasking, the interrupt cannot be missed
+                executor::wait_irq(GIC_SOURCE_UART0);
+                uart_unmask(INT_TX);
+                return Poll::Pending;
+            }
+            let c = self.buf[self.pos];
+            unsafe { write_volatile(addr_of_mut!((*uart0()).DR), c as u32) };
+            self.pos += 1;
+        }
+        Poll::Ready(self.pos)
+    }
+}
+
+pub struct UartRead<'a> {
+    buf: &'a mut [u8],
+}
+
+// Resolves once at least one byte has been received, to the number of bytes
+// stored in `buf`
+pub fn read(buf: &mut [u8]) -> UartRead<'_> {
+    UartRead { buf }
+}
+
+impl Future for UartRead<'_> {
+    type Output = usize;
+
+    fn poll(mut self: Pin<&mut Self>, _cx: &mut Context<'_>) -> Poll<usize> {
+        let mut count = 0;
+        while count < self.buf.len() && uart_fr() & FR_RXFE == 0 {
+            let dr = unsafe { read_volatile(addr_of!((*uart0()).DR)) };
+            self.buf[count] = dr as u8;
+            count += 1;
+        }
+        if count > 0 || self.buf.is_empty() {
+            return Poll::Ready(count);
+        }
+        executor::wait_irq(GIC_SOURCE_UART0);
+        // The receive timeout covers a partially filled FIFO
+        uart_unmask(INT_RX | INT_RT);
+        Poll::Pending
+    }
+}
+
+// GIC_SOURCE_UART0 handler, called from c_irq_handler() with IRQs masked
+#[no_mangle]
+#[link_section = ".text"]
+pub unsafe extern "C" fn rs_uart_irq() {
+    let uart = uart0();
+    let mis = read_volatile(addr_of!((*uart).MIS));
+    let imsc = addr_of_mut!((*uart).IMSC);
+    // The TX and RX interrupts stay raised while the FIFO level is past its
+    // threshold, the waiting future unmasks them again if it has to
+    write_volatile(imsc, read_volatile(imsc) & !mis);
+    write_volatile(addr_of_mut!((*uart).ICR), mis);
+    executor::rs_irq_wake(GIC_SOURCE_UART0);
+}
+
+// Writes `buf` `iterations` times, one UartWrite after the other. A struct
+// rather than an async fn, so it can sit in a static: the executor keeps a
+// &'static mut to it.
+struct UartBench {
+    buf: &'static [u8],
+    iterations: u32,
+    written: u32,
+    current: Option<UartWrite<'static>>,
+}
+
+impl Future for UartBench {
+    type Output = ();
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<()> {
+        let this = &mut *self;
+        loop {
+            if let Some(current) = this.current.as_mut() {
+                match Pin::new(current).poll(cx) {
+                    Poll::Ready(n) => {
+                        this.written += n as u32;
+                        this.current = None;
+                    }
+                    Poll::Pending => return Poll::Pending,
+                }
+            }
+            if this.iterations == 0 {
+                return Poll::Ready(());
+            }
+            this.iterations -= 1;
+            this.current = Some(write(this.buf));
+        }
+    }
+}
+
+static mut UART_BENCH: UartBench = UartBench {
+    buf: &[],
+    iterations: 0,
+    written: 0,
+    current: None,
+};
+
+// Writes `buf` `iterations` times through the executor, for the uart_async
+// benchmark (kernel/bench.c). Returns the number of bytes written.
+#[no_mangle]
+#[link_section = ".text"]
+pub unsafe extern "C" fn rs_uart_bench(buf: *const u8, size: u32, iterations: u32) -> u32 {
+    let bench = &mut *addr_of_mut!(UART_BENCH);
+    bench.buf = core::slice::from_raw_parts(buf, size as usize);
+    bench.iterations = iterations;
+    bench.written = 0;
+    bench.current = None;
+
+    if executor::spawn(bench).is_none() {
+        return 0;
+    }
+    executor::run();
+    (*addr_of!(UART_BENCH)).written
+}
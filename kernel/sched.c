@@ -1,8 +1,17 @@
 #include "inc/sched.h"
 #include "../sys/inc/logger.h"
+#include "inc/clock.h"
+#include "inc/gic.h"
+#include "inc/loader.h"
 #include "inc/mmu.h"
-#include "inc/tasks.h"
+#include "inc/pmu.h"
+#include "inc/prof.h"
+#include "inc/stack.h"
+#include "inc/swtimer.h"
+#include "inc/trace.h"
 #include "inc/uart.h"
+#include "inc/vfp.h"
+#include "inc/vm.h"
 #include <stddef.h>
 
 #define USR_MODE 0b10000
@@ -10,7 +19,11 @@
 
 static volatile _systick_t systick = 0;
 
-__attribute__((section(".kernel.text"))) void c_systick_handler() { systick++; }
+__attribute__((section(".kernel.text"))) void c_systick_handler() {
+  systick++;
+  c_clock_update();
+  c_swtimer_tick();
+}
 
 __attribute__((section(".kernel.text"))) _systick_t c_systick_get() {
   return systick;
@@ -25,81 +38,199 @@ __attribute__((section(".kernel.text"))) void c_delay(_systick_t ticks) {
 static _task_t tasks[MAX_TASKS];
 static uint8_t task_index = 0;
 static _task_t *current_task = NULL;
+// Set by c_task_block(), consumed by the next switch
+static _task_id_t switch_hint = SCHED_NO_HINT;
+static volatile uint32_t resched_pending = 0;
+
+static inline uint32_t read_sp_usr(void);
+static inline void write_sp_usr(uint32_t val);
+static inline uint32_t read_sp_svc(void);
+static inline void write_sp_svc(uint32_t val);
+static inline void write_tpidruro(uint32_t val);
+static inline void read_lr_spsr_svc(uint32_t *lr, uint32_t *spsr);
+static inline void write_lr_spsr_svc(uint32_t lr, uint32_t spsr);
 
-/* Stack pointers for tasks */
-extern uint32_t __task0_sp;
-extern uint32_t __task1_sp;
-extern uint32_t __task2_sp;
-uint32_t *task_sp[] = {&__task0_sp, &__task1_sp, &__task2_sp};
+__attribute__((section(".kernel.text"))) _task_t *c_task_current(void) {
+  return current_task;
+}
 
-/* IRQ stack pointers for tasks */
-extern uint32_t __task0_irq_sp;
-extern uint32_t __task1_irq_sp;
-extern uint32_t __task2_irq_sp;
-uint32_t *task_irq_sp[] = {&__task0_irq_sp, &__task1_irq_sp, &__task2_irq_sp};
+// NULL if no task was loaded in the slot
+__attribute__((section(".kernel.text"))) _task_t *c_task_get(_task_id_t id) {
+  if (id >= task_index) {
+    return NULL;
+  }
+  return &tasks[id];
+}
 
 /* MMU */
 // IMPROVEMENT: Maybe the tables should be inside of each task's .data section.
 mmu_tables_t mmu_tables[MAX_TASKS] __attribute__((section(".mmu_tables")));
 
+// Builds the first IRQ frame of a task at the top of its stack: it starts at
+// `entry` with r0 = arg. The frame is written through task->stack_phy, so
+// either the MMU is off or the stack is mapped 1:1 (c_stack_map()). The
+// pointers saved in the frame and in the task are VMAs, as they are used
+// once the task's tables are active.
+__attribute__((section(".kernel.text"))) static void
+task_build_frame(_task_t *task, _task_ptr_t entry, uint32_t arg,
+                 uint32_t cpsr) {
+  // The IRQ stack sits at the top of the stack segment, the task's stack
+  // right below it.
+  uint32_t stack_top = task->stack_base + task->stack_size;
+  task->sp = (uint32_t *)(stack_top - TASK_IRQ_STACK_SIZE);
+
+  uint32_t vma_offset = task->stack_base - task->stack_phy;
+  uint32_t *frame = (uint32_t *)(task->stack_phy + task->stack_size) - 1;
+
+  // Set Up the lr to point to the task's entrypoint
+  *frame = (uint32_t)entry;
+  // Push r12 down to r0
+  for (int i = 12; i >= 0; i--) {
+    frame -= 1;
+    *frame = (i == 0) ? arg : 0;
+  }
+
+  uint32_t save_sp = (uint32_t)frame + vma_offset;
+  frame -= 1;
+  *frame = cpsr;
+  frame -= 1;
+  *frame = save_sp;
+  task->irq_sp = (uint32_t *)((uint32_t)frame + vma_offset);
+}
+
 __attribute__((section(".kernel.text"))) void
-c_task_init(_task_ptr_t entrypoint, _systick_t ticks) {
+c_task_init(const _task_image_t *image) {
 
   // Save the cpsr with the IRQ bit set, so it can be pushed to the stack
   uint32_t cpsr;
   asm volatile("mrs %0, cpsr" : "=r"(cpsr));
   asm volatile("bic %0, %0, #0x80" : "+r"(cpsr));
 
+  if (image->magic != TASK_IMAGE_MAGIC) {
+    c_log_error("Invalid task image");
+    return;
+  }
+
   if (task_index < MAX_TASKS) {
     tasks[task_index].id = task_index;
-    tasks[task_index].entrypoint = entrypoint;
-    tasks[task_index].task_ticks = ticks;
+    tasks[task_index].flags = image->flags;
+    tasks[task_index].state = TASK_READY;
+    tasks[task_index].wait_key = 0;
+    tasks[task_index].svc_lr = 0;
+    tasks[task_index].svc_spsr = 0;
+    tasks[task_index].heap_brk = TASK_HEAP_VMA;
+    tasks[task_index].heap_mapped = TASK_HEAP_VMA;
+    tasks[task_index].mmap_base = TASK_HEAP_VMA + TASK_HEAP_SIZE;
+    tasks[task_index].entrypoint = image->entrypoint;
+    tasks[task_index].task_ticks = image->ticks;
     tasks[task_index].current_ticks = 0u;
-    /* Set stack pointer for task */
-    tasks[task_index].sp = task_sp[task_index];
-    /* Set IRQ stack pointer for task */
-    tasks[task_index].irq_sp = task_irq_sp[task_index];
-
-    // Set Up the lr to point to the task's entrypoint
-    *tasks[task_index].irq_sp = (uint32_t)entrypoint;
-    // Push the registers and cpsr to the stack
-    for (int i = 0; i < 13; i++) {
-      tasks[task_index].irq_sp -= 1;
-      *tasks[task_index].irq_sp = 0;
-    }
+    tasks[task_index].stack_base = image->stack.vma;
+    tasks[task_index].stack_phy = image->stack.phy;
+    tasks[task_index].stack_size = image->stack.size;
+    tasks[task_index].image = image;
+    c_stack_paint(&tasks[task_index]);
 
-    uint32_t save_sp = (uint32_t)tasks[task_index].irq_sp;
-    tasks[task_index].irq_sp -= 1;
     // Save the cpsr with the USR mode set,
-    // so that the task1 and task2 are run in usr mode.
-    if (task_index != 0) {
+    // so that the user tasks are run in usr mode.
+    if ((image->flags & TASK_KERNEL) == 0) {
       cpsr &= ~CLR_MODE;
       cpsr |= USR_MODE;
     }
-    *tasks[task_index].irq_sp = cpsr;
-    tasks[task_index].irq_sp -= 1;
-    *tasks[task_index].irq_sp = save_sp;
+    // The MMU is not enabled yet, the frame is written through the stack's
+    // physical address
+    task_build_frame(&tasks[task_index], image->entrypoint, 0, cpsr);
 
     c_puts("The IRQ_SP would be: ");
-    c_puts_hex((uint32_t)task_irq_sp[task_index]);
+    c_puts_hex((uint32_t)tasks[task_index].irq_sp);
     c_putchar('\n');
-    c_puts("The SVC_SP would be: ");
-    c_puts_hex((uint32_t)task_sp[task_index]);
+    c_puts("The SP would be: ");
+    c_puts_hex((uint32_t)tasks[task_index].sp);
     c_putchar('\n');
 
     // Set the TTBR0 address for each task
     uint32_t *ttbr0 = mmu_tables[task_index].l1_table;
     tasks[task_index].ttbr0 = ttbr0;
-    c_mmu_fill_tables(&mmu_tables[task_index], task_index);
+    if (c_loader_load(image, &mmu_tables[task_index]) != PAGING_SUCCESS) {
+      c_log_error("Failed to load task image");
+      return;
+    }
+    c_prof_task_init(task_index, image);
 
     task_index++;
+  } else {
+    c_log_error("No task slot left for the image, raise MAX_TASKS");
   }
 }
 
+// Starts a copy of the running user task at `entry` (NULL: its image's
+// entrypoint) with r0 = arg. The copy shares the parent's memory
+// copy-on-write (vm.h) and gets a stack of its own. Returns the new task's
+// id or TASK_CLONE_FAILED.
+__attribute__((section(".kernel.text"))) int32_t
+c_task_clone(_task_ptr_t entry, uint32_t arg) {
+  _task_t *parent = current_task;
+
+  if (task_index >= MAX_TASKS || (parent->flags & TASK_KERNEL)) {
+    return TASK_CLONE_FAILED;
+  }
+  _task_t *child = &tasks[task_index];
+  child->id = task_index;
+  child->flags = parent->flags;
+  child->state = TASK_READY;
+  child->wait_key = 0;
+  child->image = parent->image;
+  child->entrypoint = entry ? entry : parent->image->entrypoint;
+  child->task_ticks = parent->task_ticks;
+  child->current_ticks = 0u;
+  child->ttbr0 = mmu_tables[task_index].l1_table;
+  if (c_vm_clone(parent, child) != PAGING_SUCCESS) {
+    c_log_error("Failed to clone the task");
+    return TASK_CLONE_FAILED;
+  }
+
+  // The new stack is mapped 1:1 in every table, the frame is written
+  // through it. A table may need a new L2 table for it and have none left.
+  for (uint32_t t = 0; t <= task_index; t++) {
+    if (c_stack_map(&mmu_tables[t], child) != PAGING_SUCCESS) {
+      c_log_error("Failed to map the clone's stack");
+      // Table t already undid its own part
+      while (t-- > 0) {
+        c_mmu_unmap_range(&mmu_tables[t], child->stack_phy, child->stack_size,
+                          NULL);
+      }
+      c_vm_clone_undo(child);
+      return TASK_CLONE_FAILED;
+    }
+  }
+  c_stack_paint(child);
+  // USR mode, IRQs enabled
+  uint32_t cpsr;
+  asm volatile("mrs %0, cpsr" : "=r"(cpsr));
+  cpsr &= ~(CLR_MODE | 0x80);
+  cpsr |= USR_MODE;
+  task_build_frame(child, child->entrypoint, arg, cpsr);
+  c_prof_task_init(task_index, parent->image);
+
+  // Visible to the scheduler from here on
+  task_index++;
+  return child->id;
+}
+
 __attribute__((section(".kernel.text"))) void c_scheduler_init(void) {
-  c_task_init(task_idle, 10u);
-  c_task_init(task1, 10u);
-  c_task_init(task2, 10u);
+  // One task per image, in slot order. Slot 0 is the idle task.
+  for (const _task_image_t *image = __task_images_start;
+       image < __task_images_end; image++) {
+    c_task_init(image);
+  }
+
+  // Every table maps all the user stacks, for c_stack_report()
+  for (uint32_t t = 0; t < task_index; t++) {
+    for (uint32_t i = 0; i < task_index; i++) {
+      if (c_stack_map(&mmu_tables[t], &tasks[i]) != PAGING_SUCCESS) {
+        c_log_error("Failed to map a task stack");
+      }
+    }
+  }
   current_task = &tasks[0];
 
   // Set the TTBR0 register
@@ -108,7 +239,9 @@ __attribute__((section(".kernel.text"))) void c_scheduler_init(void) {
   c_mmu_init();
 
   c_log_info("Scheduler init Done");
+}
 
+__attribute__((section(".kernel.text"))) void c_scheduler_start(void) {
   // Set SVC stack pointer to task0's stack before starting it for the first
   // time It's not strictly necessary, but it would be using the __svc_sp
   // (Kernel's sp) instead. Which can cause problems
@@ -117,6 +250,7 @@ __attribute__((section(".kernel.text"))) void c_scheduler_init(void) {
                "cps #0x12\n\t" // Switch back to IRQ mode
                :
                : "r"(tasks[0].sp));
+  write_tpidruro(current_task->id);
 
   // The IRQ is enabled on low, thats why bic instr is used
   // mrs r0, cpsr
@@ -127,51 +261,170 @@ __attribute__((section(".kernel.text"))) void c_scheduler_init(void) {
   asm volatile("cpsie i");
   current_task->entrypoint();
 }
-static inline uint32_t read_sp_usr(void);
-static inline void write_sp_usr(uint32_t val);
-static inline uint32_t read_sp_svc(void);
-static inline void write_sp_svc(uint32_t val);
+
+// Saves the running task's stack pointer and switches to the next task:
+// the hinted one if it can run, else the next READY one in round-robin
+// order. The idle task (slot 0) never blocks, so there always is one.
+__attribute__((section(".kernel.text"))) static void sched_switch(void) {
+  // A kernel task may be preempted in the middle of a leaf function that
+  // still returns through lr
+  if (current_task->flags & TASK_KERNEL) {
+    current_task->sp = (uint32_t *)read_sp_svc();
+    read_lr_spsr_svc(&current_task->svc_lr, &current_task->svc_spsr);
+  } else {
+    current_task->sp = (uint32_t *)read_sp_usr();
+  }
+
+  current_task->current_ticks = 0u;
+  uint8_t id = current_task->id;
+  if (switch_hint < task_index && tasks[switch_hint].state == TASK_READY) {
+    id = switch_hint;
+  } else {
+    do {
+      if (++id >= task_index) {
+        id = 0;
+      }
+    } while (tasks[id].state != TASK_READY);
+  }
+  switch_hint = SCHED_NO_HINT;
+  resched_pending = 0;
+  TRACEPOINT_ARG(TRACE_SCHED_SWITCH, id);
+  c_log_taskswitch(id);
+  current_task = &tasks[id];
+
+  if (current_task->flags & TASK_KERNEL) {
+    write_sp_svc((uint32_t)current_task->sp);
+    write_lr_spsr_svc(current_task->svc_lr, current_task->svc_spsr);
+  } else {
+    write_sp_usr((uint32_t)current_task->sp);
+  }
+
+  // Set the TTBR0 of the current_task
+  mmu_switch_tables(current_task->ttbr0);
+
+  // FP stays enabled only if the new task owns the VFP registers
+  c_vfp_switch(current_task->id);
+  write_tpidruro(current_task->id);
+}
+
 __attribute__((section(".kernel.text"))) uint32_t c_scheduler(_ctx_t *ctx) {
   current_task->current_ticks++;
-  if (current_task->current_ticks >= current_task->task_ticks) {
-    if (current_task->id == 0) {
-      current_task->sp = (uint32_t *)read_sp_svc();
-    } else {
-      current_task->sp = (uint32_t *)read_sp_usr();
-    }
+  if (current_task->current_ticks >= current_task->task_ticks ||
+      current_task->state != TASK_READY) {
+    sched_switch();
+  }
+  return (uint32_t)current_task->irq_sp;
+}
+
+// GIC_SGI_RESCHED handler. The timer tick may have switched already.
+__attribute__((section(".kernel.text"))) uint32_t
+c_scheduler_yield(_ctx_t *ctx) {
+  if (resched_pending) {
+    sched_switch();
+  }
+  return (uint32_t)current_task->irq_sp;
+}
 
-    current_task->current_ticks = 0u;
-    uint8_t id = current_task->id;
-    id = (id + 1) % MAX_TASKS;
-    c_log_taskswitch(id);
-    current_task = &tasks[id];
+// Blocks the running task on a futex key and raises GIC_SGI_RESCHED. Called
+// with IRQs masked from a system call: the SGI is taken as soon as the task
+// returns to USR mode, and its context is saved right after the swi.
+__attribute__((section(".kernel.text"))) void c_task_block(uintptr_t key,
+                                                           _task_id_t hint) {
+  _gicd_t *const GICD0 = (_gicd_t *)GICD0_ADDR;
 
-    if (current_task->id == 0) {
-      write_sp_svc((uint32_t)current_task->sp);
-    } else {
-      write_sp_usr((uint32_t)current_task->sp);
+  current_task->state = TASK_BLOCKED;
+  current_task->wait_key = key;
+  switch_hint = hint;
+  resched_pending = 1;
+  GICD0->SGIR = GICD_SGIR_TARGET_SELF | GIC_SGI_RESCHED;
+}
+
+// Makes `hint` the next task to run, through GIC_SGI_RESCHED as soon as
+// IRQs are enabled (or the IRQ handler returns).
+__attribute__((section(".kernel.text"))) void c_sched_kick(_task_id_t hint) {
+  _gicd_t *const GICD0 = (_gicd_t *)GICD0_ADDR;
+
+  switch_hint = hint;
+  resched_pending = 1;
+  GICD0->SGIR = GICD_SGIR_TARGET_SELF | GIC_SGI_RESCHED;
+}
+
+// Stops the running task for good, it is switched out once the caller returns
+// and the reschedule SGI is taken.
+__attribute__((section(".kernel.text"))) void c_task_stop(void) {
+  _gicd_t *const GICD0 = (_gicd_t *)GICD0_ADDR;
+
+  current_task->state = TASK_STOPPED;
+  current_task->wait_key = 0;
+  switch_hint = SCHED_NO_HINT;
+  resched_pending = 1;
+  GICD0->SGIR = GICD_SGIR_TARGET_SELF | GIC_SGI_RESCHED;
+}
+
+// Readies up to `count` tasks blocked on the key, returns how many
+__attribute__((section(".kernel.text"))) uint32_t c_task_wake(uintptr_t key,
+                                                              uint32_t count) {
+  uint32_t woken = 0;
+  uint8_t id = current_task->id;
+
+  for (uint32_t i = 0; i < task_index && woken < count; i++) {
+    if (++id >= task_index) {
+      id = 0;
     }
+    if (tasks[id].state == TASK_BLOCKED && tasks[id].wait_key == key) {
+      tasks[id].state = TASK_READY;
+      tasks[id].wait_key = 0;
+      woken++;
+    }
+  }
+  return woken;
+}
+
+// The task's IRQ frame sits at irq_sp in its own tables, and its stack is
+// also mapped 1:1 in every table (c_stack_map())
+__attribute__((section(".kernel.text"))) void
+c_task_set_result(_task_t *task, uint32_t value) {
+  _ctx_t *ctx = (_ctx_t *)((uint32_t)task->irq_sp -
+                           (task->stack_base - task->stack_phy));
+  ctx->registers[0] = value;
+}
+
+#ifdef CONFIG_BENCH
+// Forces `count` task switches through c_scheduler() and returns the cycles
+// they took. It has to run in IRQ mode, like c_scheduler() itself, so the
+// banked SVC/USR stack pointers it swaps are not the caller's. The tasks and
+// the SVC stack pointer are put back as they were before returning.
+__attribute__((section(".kernel.text"))) uint32_t
+c_scheduler_bench(uint32_t count) {
+  uint32_t *saved_sp[MAX_TASKS];
+  uint32_t svc_sp = read_sp_svc();
+  uint32_t usr_sp = read_sp_usr();
 
-    // Used for debugging purposes
-    //  for (int i = 0; i < 16; i++) {
-    //    if (i == 15) {
-    //      c_puts("The PC would be: ");
-    //      c_puts_hex(current_task->irq_sp[i]);
-    //      c_putchar('\n');
-    //      c_puts("The SP would be: ");
-    //      c_puts_hex((uint32_t)current_task->svc_sp);
-    //      c_putchar('\n');
-    //    } else {
-    //      c_puts_hex(current_task->irq_sp[i]);
-    //      c_putchar('\n');
-    //    }
-    //  }
-
-    // Set the TTBR0 of the current_task
-    __asm__ volatile("mcr p15, 0, %0, c2, c0, 0" : : "r"(current_task->ttbr0));
+  for (uint32_t i = 0; i < task_index; i++) {
+    saved_sp[i] = tasks[i].sp;
   }
-  return (uint32_t)current_task->irq_sp;
+
+  uint32_t start = pmu_cycles();
+  for (uint32_t i = 0; i < count; i++) {
+    current_task->current_ticks = current_task->task_ticks;
+    c_scheduler(NULL);
+  }
+  uint32_t cycles = pmu_cycles() - start;
+
+  for (uint32_t i = 0; i < task_index; i++) {
+    tasks[i].sp = saved_sp[i];
+    tasks[i].current_ticks = 0u;
+  }
+  current_task = &tasks[0];
+  mmu_switch_tables(current_task->ttbr0);
+  c_vfp_switch(current_task->id);
+  write_tpidruro(current_task->id);
+  write_sp_usr(usr_sp);
+  write_sp_svc(svc_sp);
+
+  return cycles;
 }
+#endif
 
 // https://developer.arm.com/documentation/ddi0406/cb/System-Level-Architecture/System-Instructions/Encoding-and-use-of-Banked-register-transfer-instructions/Register-arguments-in-the-Banked-register-transfer-instructions?lang=en
 // The SYSTEM mode uses the same sp register as USER mode
@@ -210,3 +463,32 @@ static inline void write_sp_svc(uint32_t val) {
                "msr cpsr_c, r1\n\t" ::"r"(val)
                : "r1");
 }
+
+// lr is clobbered so it is never picked for an operand: it would name the
+// SVC lr once in SVC mode
+static inline void read_lr_spsr_svc(uint32_t *lr, uint32_t *spsr) {
+  uint32_t l, p;
+  asm volatile("mrs r1, cpsr\n\t"
+               "cps #0x13\n\t"
+               "mov %0, lr\n\t"
+               "mrs %1, spsr\n\t"
+               "msr cpsr_c, r1\n\t"
+               : "=&r"(l), "=&r"(p)::"r1", "lr");
+  *lr = l;
+  *spsr = p;
+}
+
+static inline void write_lr_spsr_svc(uint32_t lr, uint32_t spsr) {
+  asm volatile("mrs r1, cpsr\n\t"
+               "cps #0x13\n\t"
+               "mov lr, %0\n\t"
+               "msr spsr_cxsf, %1\n\t"
+               "msr cpsr_c, r1\n\t" ::"r"(lr),
+               "r"(spsr)
+               : "r1", "lr");
+}
+
+// User read-only thread ID register, read by task_self()
+static inline void write_tpidruro(uint32_t val) {
+  asm volatile("mcr p15, 0, %0, c13, c0, 3" ::"r"(val));
+}
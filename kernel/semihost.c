@@ -0,0 +1,56 @@
+#include "inc/semihost.h"
+
+// The operation goes in r0, its argument (or a pointer to its parameter
+// block) in r1, the result comes back in r0.
+__attribute__((section(".kernel.text"))) uint32_t
+c_semihost_call(uint32_t op, uint32_t arg) {
+  register uint32_t r0 asm("r0") = op;
+  register uint32_t r1 asm("r1") = arg;
+  // lr is lost if the svc is taken as a real exception from SVC mode
+  asm volatile("svc %2"
+               : "+r"(r0)
+               : "r"(r1), "i"(SEMIHOST_SVC)
+               : "lr", "memory");
+  return r0;
+}
+
+__attribute__((section(".kernel.text"))) void c_semihost_exit(uint32_t reason) {
+  c_semihost_call(SEMIHOST_SYS_EXIT, reason);
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_semihost_open(const char *path, uint32_t mode) {
+  uint32_t block[3];
+  uint32_t len = 0;
+
+  while (path[len]) {
+    len++;
+  }
+  block[0] = (uint32_t)path;
+  block[1] = mode;
+  block[2] = len;
+  return (int32_t)c_semihost_call(SEMIHOST_SYS_OPEN, (uint32_t)block);
+}
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_semihost_write(int32_t handle, const void *buf, uint32_t size) {
+  uint32_t block[3];
+
+  block[0] = (uint32_t)handle;
+  block[1] = (uint32_t)buf;
+  block[2] = size;
+  return c_semihost_call(SEMIHOST_SYS_WRITE, (uint32_t)block);
+}
+
+__attribute__((section(".kernel.text"))) int32_t
+c_semihost_close(int32_t handle) {
+  uint32_t block[1];
+
+  block[0] = (uint32_t)handle;
+  return (int32_t)c_semihost_call(SEMIHOST_SYS_CLOSE, (uint32_t)block);
+}
+
+__attribute__((section(".kernel.text"))) void
+c_semihost_write0(const char *s) {
+  c_semihost_call(SEMIHOST_SYS_WRITE0, (uint32_t)s);
+}
@@ -0,0 +1,121 @@
+#include "inc/slab.h"
+#include "../sys/inc/logger.h"
+#include "inc/irq.h"
+#include "inc/page.h"
+#include <stddef.h>
+
+static _slab_cache_t *slab_caches = NULL;
+
+__attribute__((section(".kernel.text"))) void
+c_slab_cache_init(_slab_cache_t *cache, const char *name, uint32_t size) {
+  if (size < sizeof(void *)) {
+    size = sizeof(void *);
+  }
+  cache->name = name;
+  cache->obj_size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+  cache->objs_per_slab = 0;
+  for (uint32_t off = 0; off + cache->obj_size <= PAGE_SIZE;
+       off += cache->obj_size) {
+    cache->objs_per_slab++;
+  }
+  cache->free_list = NULL;
+  cache->slabs = 0;
+  cache->in_use = 0;
+  cache->allocs = 0;
+  cache->frees = 0;
+  cache->failures = 0;
+
+  uint32_t cpsr = irq_save();
+  cache->next = slab_caches;
+  slab_caches = cache;
+  irq_restore(cpsr);
+}
+
+// Chains the objects of a new slab into the free list. IRQs are masked.
+static uint32_t slab_grow(_slab_cache_t *cache) {
+  uint8_t *slab = c_page_alloc(1);
+  if (slab == NULL || cache->objs_per_slab == 0) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < cache->objs_per_slab; i++) {
+    void **obj = (void **)(slab + i * cache->obj_size);
+    *obj = cache->free_list;
+    cache->free_list = obj;
+  }
+  cache->slabs++;
+  return 1;
+}
+
+__attribute__((section(".kernel.text"))) void *
+c_slab_alloc(_slab_cache_t *cache) {
+  uint32_t cpsr = irq_save();
+
+  if (cache->free_list == NULL && !slab_grow(cache)) {
+    cache->failures++;
+    irq_restore(cpsr);
+    return NULL;
+  }
+  void **obj = cache->free_list;
+  cache->free_list = *obj;
+  cache->in_use++;
+  cache->allocs++;
+  irq_restore(cpsr);
+  return obj;
+}
+
+__attribute__((section(".kernel.text"))) void c_slab_free(_slab_cache_t *cache,
+                                                          void *obj) {
+  if (obj == NULL) {
+    return;
+  }
+  uint32_t cpsr = irq_save();
+  *(void **)obj = cache->free_list;
+  cache->free_list = obj;
+  cache->in_use--;
+  cache->frees++;
+  irq_restore(cpsr);
+}
+
+__attribute__((section(".kernel.text"))) void c_slab_stats(void) {
+  _page_zone_t *zones[2] = {&page_zone_kernel, &page_zone_user};
+
+  c_log_info("Kernel heap:");
+  for (uint32_t i = 0; i < 2; i++) {
+    c_puts("  ");
+    c_puts(zones[i]->name);
+    c_puts(" pages used/total: ");
+    c_puts_hex(zones[i]->used);
+    c_puts(" / ");
+    c_puts_hex(zones[i]->total);
+    c_puts(" failures=");
+    c_puts_hex(zones[i]->failures);
+    c_putchar('\n');
+  }
+  c_puts("  zero pool: ");
+  c_puts_hex(page_zero_pool.count);
+  c_puts(" / ");
+  c_puts_hex(PAGE_ZERO_POOL);
+  c_puts(" hits=");
+  c_puts_hex(page_zero_pool.hits);
+  c_puts(" misses=");
+  c_puts_hex(page_zero_pool.misses);
+  c_putchar('\n');
+  for (_slab_cache_t *cache = slab_caches; cache != NULL;
+       cache = cache->next) {
+    c_puts("  ");
+    c_puts(cache->name);
+    c_puts(": size=");
+    c_puts_hex(cache->obj_size);
+    c_puts(" slabs=");
+    c_puts_hex(cache->slabs);
+    c_puts(" in_use=");
+    c_puts_hex(cache->in_use);
+    c_puts(" allocs=");
+    c_puts_hex(cache->allocs);
+    c_puts(" frees=");
+    c_puts_hex(cache->frees);
+    c_puts(" failures=");
+    c_puts_hex(cache->failures);
+    c_putchar('\n');
+  }
+}
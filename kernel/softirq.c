@@ -0,0 +1,107 @@
+#include "inc/softirq.h"
+#include "inc/irq.h"
+#include "inc/sched.h"
+#include <stddef.h>
+
+static _softirq_handler_t softirq_handlers[SOFTIRQ_COUNT];
+static volatile uint32_t softirq_pending = 0;
+// FIFO of queued work items
+static _work_t *work_head = NULL;
+static _work_t *work_tail = NULL;
+// Set once the kworker runs
+static _task_id_t kworker_id = SCHED_NO_HINT;
+
+// The kworker blocks on its own key, nothing else uses it
+#define KWORKER_KEY ((uintptr_t)&kworker_id)
+
+__attribute__((section(".kernel.text"))) void
+c_softirq_register(uint32_t nr, _softirq_handler_t handler) {
+  if (nr < SOFTIRQ_COUNT) {
+    softirq_handlers[nr] = handler;
+  }
+}
+
+__attribute__((section(".kernel.text"))) void c_softirq_raise(uint32_t nr) {
+  uint32_t cpsr = irq_save();
+  softirq_pending |= 1u << nr;
+  irq_restore(cpsr);
+}
+
+// Runs with IRQs masked, in IRQ mode
+__attribute__((section(".kernel.text"))) void c_softirq_irq_exit(void) {
+  if (softirq_pending == 0 && work_head == NULL) {
+    return;
+  }
+  if (kworker_id == SCHED_NO_HINT || task_self() == kworker_id) {
+    return;
+  }
+  c_task_wake(KWORKER_KEY, 1);
+  c_sched_kick(kworker_id);
+}
+
+__attribute__((section(".kernel.text"))) void
+c_work_init(_work_t *work, void (*fn)(_work_t *work)) {
+  work->next = NULL;
+  work->fn = fn;
+  work->queued = 0;
+}
+
+__attribute__((section(".kernel.text"))) void c_work_queue(_work_t *work) {
+  uint32_t cpsr = irq_save();
+  if (!work->queued) {
+    work->queued = 1;
+    work->next = NULL;
+    if (work_tail != NULL) {
+      work_tail->next = work;
+    } else {
+      work_head = work;
+    }
+    work_tail = work;
+  }
+  irq_restore(cpsr);
+}
+
+// Pops the next work item, NULL if the queue is empty
+__attribute__((section(".kernel.text"))) static _work_t *work_pop(void) {
+  uint32_t cpsr = irq_save();
+  _work_t *work = work_head;
+  if (work != NULL) {
+    work_head = work->next;
+    if (work_head == NULL) {
+      work_tail = NULL;
+    }
+    // It may be queued again while it runs
+    work->queued = 0;
+  }
+  irq_restore(cpsr);
+  return work;
+}
+
+// Kernel task, runs in SVC mode with IRQs enabled
+__attribute__((section(".kernel.text"))) void task_kworker(void) {
+  kworker_id = task_self();
+
+  while (1) {
+    uint32_t cpsr = irq_save();
+    uint32_t pending = softirq_pending;
+    softirq_pending = 0;
+    if (pending == 0 && work_head == NULL) {
+      // The reschedule SGI is taken as soon as IRQs are unmasked
+      c_task_block(KWORKER_KEY, SCHED_NO_HINT);
+      irq_restore(cpsr);
+      continue;
+    }
+    irq_restore(cpsr);
+
+    for (uint32_t nr = 0; pending != 0; nr++, pending >>= 1) {
+      if ((pending & 1) && softirq_handlers[nr] != NULL) {
+        softirq_handlers[nr]();
+      }
+    }
+
+    _work_t *work;
+    while ((work = work_pop()) != NULL) {
+      work->fn(work);
+    }
+  }
+}
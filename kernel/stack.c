@@ -0,0 +1,78 @@
+#include "inc/stack.h"
+#include "../sys/inc/logger.h"
+#include "inc/loader.h"
+#include <stddef.h>
+
+// The painted part of a task's stack, below the IRQ frame
+static inline uint32_t stack_paint_size(const _task_t *task) {
+  return task->stack_size - TASK_IRQ_STACK_SIZE;
+}
+
+// Runs before the MMU is enabled, the stack is painted through its physical
+// address.
+__attribute__((section(".kernel.text"))) void
+c_stack_paint(const _task_t *task) {
+  uint32_t *word = (uint32_t *)task->stack_phy;
+  uint32_t count = stack_paint_size(task) >> 2;
+  for (uint32_t i = 0; i < count; i++) {
+    word[i] = STACK_PAINT;
+  }
+}
+
+// Maps a user task's stack at its physical address, kernel only, so the
+// high-water mark can be read whatever task's tables are active. Kernel task
+// stacks are in the kernel stack region, already mapped.
+__attribute__((section(".kernel.text"))) int32_t
+c_stack_map(mmu_tables_t *tables, const _task_t *task) {
+  if (task->flags & TASK_KERNEL) {
+    return PAGING_SUCCESS;
+  }
+  _mmu_map_t map;
+  map.va = task->stack_phy;
+  map.pa = task->stack_phy;
+  map.size = task->stack_size;
+  map.flags = c_loader_l2_flags(SEG_WRITE);
+  return c_mmu_map_batch(tables, &map, 1);
+}
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_stack_guard_hit(const _task_t *task, uint32_t fault_addr) {
+  if (task->flags & TASK_KERNEL) {
+    return 0;
+  }
+  return fault_addr < task->stack_base &&
+         fault_addr >= task->stack_base - STACK_GUARD_SIZE;
+}
+
+// Bytes of the painted part that have been written at least once. The
+// stack grows down, so the scan goes up from the bottom to the first word
+// that lost the pattern.
+__attribute__((section(".kernel.text"))) uint32_t
+c_stack_used(const _task_t *task) {
+  const uint32_t *word = (const uint32_t *)task->stack_phy;
+  uint32_t count = stack_paint_size(task) >> 2;
+  uint32_t i = 0;
+  while (i < count && word[i] == STACK_PAINT) {
+    i++;
+  }
+  return (count - i) << 2;
+}
+
+__attribute__((section(".kernel.text"))) void c_stack_report(void) {
+  for (_task_id_t id = 0; id < MAX_TASKS; id++) {
+    const _task_t *task = c_task_get(id);
+    if (task == NULL) {
+      break;
+    }
+    c_puts("STACK task=");
+    c_puts_hex(task->id);
+    c_puts(" used=");
+    c_puts_hex(c_stack_used(task));
+    c_puts(" size=");
+    c_puts_hex(stack_paint_size(task));
+    if (task->state == TASK_STOPPED) {
+      c_puts(" stopped");
+    }
+    c_putchar('\n');
+  }
+}
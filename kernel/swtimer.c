@@ -0,0 +1,176 @@
+#include "inc/swtimer.h"
+#include "inc/irq.h"
+#include "inc/slab.h"
+#include "inc/softirq.h"
+#include <stddef.h>
+
+static _swtimer_link_t wheel[SWTIMER_LEVELS][SWTIMER_SLOTS];
+static _swtimer_link_t expired;
+// Tick the wheel has been advanced to, follows the systick
+static _systick_t wheel_now = 0;
+static _slab_cache_t swtimer_cache;
+
+static inline void list_init(_swtimer_link_t *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+static inline void list_add_tail(_swtimer_link_t *head, _swtimer_link_t *link) {
+  link->next = head;
+  link->prev = head->prev;
+  head->prev->next = link;
+  head->prev = link;
+}
+
+static inline void list_del(_swtimer_link_t *link) {
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->next = NULL;
+  link->prev = NULL;
+}
+
+// Moves every link of src to the end of dst
+static inline void list_splice_tail(_swtimer_link_t *dst,
+                                    _swtimer_link_t *src) {
+  if (src->next == src) {
+    return;
+  }
+  src->next->prev = dst->prev;
+  dst->prev->next = src->next;
+  src->prev->next = dst;
+  dst->prev = src->prev;
+  list_init(src);
+}
+
+// Picks the level by the distance to the expiry and the slot by the bits of
+// the expiry tick for that level.
+static void wheel_insert(_swtimer_t *timer) {
+  _systick_t delta = timer->expires - wheel_now;
+  uint32_t level = 0;
+
+  while (level < SWTIMER_LEVELS - 1 &&
+         delta >= (1u << (SWTIMER_SLOT_BITS * (level + 1)))) {
+    level++;
+  }
+  uint32_t slot =
+      (timer->expires >> (SWTIMER_SLOT_BITS * level)) & SWTIMER_SLOT_MASK;
+  list_add_tail(&wheel[level][slot], &timer->link);
+}
+
+// Redistributes a slot of an upper level into the levels below
+static void wheel_cascade(uint32_t level, uint32_t slot) {
+  _swtimer_link_t pending;
+
+  list_init(&pending);
+  list_splice_tail(&pending, &wheel[level][slot]);
+  while (pending.next != &pending) {
+    _swtimer_t *timer = (_swtimer_t *)pending.next;
+    list_del(&timer->link);
+    wheel_insert(timer);
+  }
+}
+
+__attribute__((section(".kernel.text"))) void c_swtimer_wheel_init(void) {
+  for (uint32_t level = 0; level < SWTIMER_LEVELS; level++) {
+    for (uint32_t slot = 0; slot < SWTIMER_SLOTS; slot++) {
+      list_init(&wheel[level][slot]);
+    }
+  }
+  list_init(&expired);
+  wheel_now = c_systick_get();
+  c_slab_cache_init(&swtimer_cache, "swtimer", sizeof(_swtimer_t));
+  c_softirq_register(SOFTIRQ_TIMER, c_swtimer_run_expired);
+}
+
+__attribute__((section(".kernel.text"))) void
+c_swtimer_init(_swtimer_t *timer, _swtimer_cb_t callback, void *arg) {
+  timer->link.next = NULL;
+  timer->link.prev = NULL;
+  timer->callback = callback;
+  timer->arg = arg;
+}
+
+__attribute__((section(".kernel.text"))) _swtimer_t *
+c_swtimer_create(_swtimer_cb_t callback, void *arg) {
+  _swtimer_t *timer = c_slab_alloc(&swtimer_cache);
+  if (timer != NULL) {
+    c_swtimer_init(timer, callback, arg);
+  }
+  return timer;
+}
+
+__attribute__((section(".kernel.text"))) void
+c_swtimer_destroy(_swtimer_t *timer) {
+  c_swtimer_cancel(timer);
+  c_slab_free(&swtimer_cache, timer);
+}
+
+// (Re)arms the timer to expire in `ticks` systicks
+__attribute__((section(".kernel.text"))) void c_swtimer_add(_swtimer_t *timer,
+                                                            _systick_t ticks) {
+  if (ticks == 0) {
+    ticks = 1;
+  } else if (ticks > SWTIMER_MAX_TICKS) {
+    ticks = SWTIMER_MAX_TICKS;
+  }
+
+  uint32_t cpsr = irq_save();
+  if (timer->link.next != NULL) {
+    list_del(&timer->link);
+  }
+  timer->expires = wheel_now + ticks;
+  wheel_insert(timer);
+  irq_restore(cpsr);
+}
+
+// Also removes a timer that expired but whose callback did not run yet
+__attribute__((section(".kernel.text"))) void
+c_swtimer_cancel(_swtimer_t *timer) {
+  uint32_t cpsr = irq_save();
+  if (timer->link.next != NULL) {
+    list_del(&timer->link);
+  }
+  irq_restore(cpsr);
+}
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_swtimer_pending(const _swtimer_t *timer) {
+  return timer->link.next != NULL;
+}
+
+// Called from c_systick_handler(), in the timer IRQ
+__attribute__((section(".kernel.text"))) void c_swtimer_tick(void) {
+  wheel_now++;
+
+  // Every time a level wraps, the next slot of the level above is cascaded
+  for (uint32_t level = 1; level < SWTIMER_LEVELS; level++) {
+    if (((wheel_now >> (SWTIMER_SLOT_BITS * (level - 1))) &
+         SWTIMER_SLOT_MASK) != 0) {
+      break;
+    }
+    uint32_t slot =
+        (wheel_now >> (SWTIMER_SLOT_BITS * level)) & SWTIMER_SLOT_MASK;
+    wheel_cascade(level, slot);
+  }
+
+  list_splice_tail(&expired, &wheel[0][wheel_now & SWTIMER_SLOT_MASK]);
+  if (expired.next != &expired) {
+    c_softirq_raise(SOFTIRQ_TIMER);
+  }
+}
+
+// Runs the callbacks of the expired timers. A callback may re-arm its timer.
+__attribute__((section(".kernel.text"))) void c_swtimer_run_expired(void) {
+  while (1) {
+    uint32_t cpsr = irq_save();
+    if (expired.next == &expired) {
+      irq_restore(cpsr);
+      return;
+    }
+    _swtimer_t *timer = (_swtimer_t *)expired.next;
+    list_del(&timer->link);
+    irq_restore(cpsr);
+
+    timer->callback(timer->arg);
+  }
+}
@@ -0,0 +1,85 @@
+#include "inc/syscall.h"
+#include "../sys/inc/logger.h"
+#include "inc/clock.h"
+#include "inc/dma.h"
+#include "inc/futex.h"
+#include "inc/latency.h"
+#include "inc/prof.h"
+#include "inc/sched.h"
+#include "inc/semihost.h"
+#include "inc/slab.h"
+#include "inc/stack.h"
+#include "inc/trace.h"
+#include "inc/uring.h"
+#include "inc/vm.h"
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_swi_handler(uint32_t number, uint32_t *args) {
+  TRACEPOINT_ARG(TRACE_SYSCALL, number);
+
+  switch (number) {
+  case SYS_PROF_DUMP:
+    c_prof_dump();
+    return 0;
+
+  case SYS_LAT_REPORT:
+    c_lat_report(args[0]);
+    return 0;
+
+  case SYS_FUTEX_WAIT:
+    return c_futex_wait((volatile uint32_t *)args[0], args[1], args[2]);
+
+  case SYS_FUTEX_WAKE:
+    return c_futex_wake((volatile uint32_t *)args[0], args[1]);
+
+  case SYS_HEAP_STATS:
+    c_slab_stats();
+    return 0;
+
+  case SYS_BRK:
+    return c_vm_brk(args[0]);
+
+  case SYS_MMAP:
+    return c_vm_mmap(args[0]);
+
+  case SYS_UART_WRITE:
+    return c_dma_uart_write((const void *)args[0], args[1]);
+
+  case SYS_STACK_REPORT:
+    c_stack_report();
+    return 0;
+
+  case SYS_CLONE:
+    return c_task_clone((_task_ptr_t)args[0], args[1]);
+
+#ifndef BOARD_TIMER_SP804
+  case SYS_CLOCK_RAW:
+    return clock_read_raw();
+#endif
+
+  case SYS_TRACE:
+    if (args[1]) {
+      c_trace_dump();
+    }
+    return c_trace_enable(args[0]);
+
+  case SYS_URING_SETUP:
+    return c_uring_setup(args[0]);
+
+  case SYS_URING_ENTER:
+    return c_uring_enter(args[0]);
+
+  case SYS_NOP:
+    return 0;
+
+  // Only trapped when QEMU runs without -semihosting
+  case SEMIHOST_SVC:
+    return (uint32_t)-1;
+
+  default:
+    c_log_info("SWI Handler with number:");
+    c_puts_hex(number);
+    c_putchar('\n');
+    return 0;
+  }
+}
@@ -1,18 +1,132 @@
 #include "inc/tasks.h"
 #include "../sys/inc/logger.h"
+#include "inc/latency.h"
+#include "inc/loader.h"
+#include "inc/membench.h"
 #include "inc/mmu.h"
+#include "inc/page.h"
+#include "inc/prof.h"
 #include "inc/sched.h"
+#include "inc/softirq.h"
+#include "inc/stack.h"
+#include "inc/syscall.h"
 #include "inc/uart.h"
+#include "inc/uring.h"
+
+// Linker symbols of the task sections (see linker/mmap.ld)
+DECLARE_TASK_SEGMENT(TASK0, TEXT);
+extern uint32_t _task0_stack_end;
+extern uint8_t _TASK0_STACK_SIZE;
+
+// The kworker runs kernel code only, it needs no segments of its own
+extern uint32_t _kworker_stack_end;
+extern uint8_t _KWORKER_STACK_SIZE;
+
+DECLARE_TASK_SEGMENT(TASK1, TEXT);
+DECLARE_TASK_SEGMENT(TASK1, DATA);
+DECLARE_TASK_SEGMENT(TASK1, RODATA);
+DECLARE_TASK_SEGMENT(TASK1, BSS);
+extern uint32_t _TASK1_STACK, _TASK1_STACK_PHY;
+extern uint8_t _TASK1_STACK_SIZE;
+extern uint32_t _TASK1_RAREA_START_VMA, _TASK1_RAREA_END_VMA,
+    _TASK1_RAREA_START_PHY;
+extern uint8_t _TASK1_RAREA_SIZE;
+#define TASK1_RAREA_SIZE_B                                                     \
+  ((uint32_t)(GET_SYMBOL_VALUE(_TASK1_RAREA_END_VMA) -                         \
+              GET_SYMBOL_VALUE(_TASK1_RAREA_START_VMA) + 1))
+
+DECLARE_TASK_SEGMENT(TASK2, TEXT);
+DECLARE_TASK_SEGMENT(TASK2, DATA);
+DECLARE_TASK_SEGMENT(TASK2, RODATA);
+DECLARE_TASK_SEGMENT(TASK2, BSS);
+extern uint32_t _TASK2_STACK, _TASK2_STACK_PHY;
+extern uint8_t _TASK2_STACK_SIZE;
+extern uint32_t _TASK2_RAREA_START_VMA, _TASK2_RAREA_END_VMA,
+    _TASK2_RAREA_START_PHY;
+extern uint8_t _TASK2_RAREA_SIZE;
+#define TASK2_RAREA_SIZE_B                                                     \
+  ((uint32_t)(GET_SYMBOL_VALUE(_TASK2_RAREA_END_VMA) -                         \
+              GET_SYMBOL_VALUE(_TASK2_RAREA_START_VMA) + 1))
+
+// Shared user library, mapped into every user task
+DECLARE_TASK_SEGMENT(ULIB, TEXT);
+
+// Task images, loaded by c_scheduler_init() in slot order
+TASK_IMAGE(0, task_idle, 10u, TASK_KERNEL,
+           TASK_STACK_SEGMENT(_task0_stack_end, _task0_stack_end,
+                              _TASK0_STACK_SIZE),
+           TASK_LOAD_SEGMENT(TASK0, TEXT, SEG_WRITE | SEG_EXEC));
+
+TASK_IMAGE(1, task1, 10u, 0,
+           TASK_STACK_SEGMENT(_TASK1_STACK, _TASK1_STACK_PHY,
+                              _TASK1_STACK_SIZE),
+           TASK_LOAD_SEGMENT(TASK1, TEXT, SEG_USER | SEG_EXEC),
+           TASK_LOAD_SEGMENT(TASK1, DATA, SEG_USER | SEG_WRITE),
+           TASK_LOAD_SEGMENT(TASK1, RODATA, SEG_USER),
+           TASK_ZERO_SEGMENT(TASK1, BSS, SEG_USER | SEG_WRITE),
+           TASK_SEGMENT(_TASK1_RAREA_START_VMA, _TASK1_RAREA_START_PHY, 0,
+                        _TASK1_RAREA_SIZE, SEG_USER | SEG_WRITE),
+           TASK_LOAD_SEGMENT(ULIB, TEXT, SEG_USER | SEG_EXEC));
+
+TASK_IMAGE(2, task2, 10u, 0,
+           TASK_STACK_SEGMENT(_TASK2_STACK, _TASK2_STACK_PHY,
+                              _TASK2_STACK_SIZE),
+           TASK_LOAD_SEGMENT(TASK2, TEXT, SEG_USER | SEG_EXEC),
+           TASK_LOAD_SEGMENT(TASK2, DATA, SEG_USER | SEG_WRITE),
+           TASK_LOAD_SEGMENT(TASK2, RODATA, SEG_USER),
+           TASK_ZERO_SEGMENT(TASK2, BSS, SEG_USER | SEG_WRITE),
+           TASK_SEGMENT(_TASK2_RAREA_START_VMA, _TASK2_RAREA_START_PHY, 0,
+                        _TASK2_RAREA_SIZE, SEG_USER | SEG_WRITE),
+           TASK_LOAD_SEGMENT(ULIB, TEXT, SEG_USER | SEG_EXEC));
+
+TASK_IMAGE(3, task_kworker, 10u, TASK_KERNEL,
+           TASK_STACK_SEGMENT(_kworker_stack_end, _kworker_stack_end,
+                              _KWORKER_STACK_SIZE));
 
 __attribute__((section(".task0.text"))) void task_idle() {
   c_putsln("[TASK0] first execution");
+#ifdef CONFIG_PROF
+  _systick_t last_dump = c_systick_get();
+#endif
+#ifdef CONFIG_LATENCY
+  _systick_t last_report = c_systick_get();
+#endif
+#ifdef CONFIG_STACK_REPORT
+  _systick_t last_stack_report = c_systick_get();
+#endif
   while (1) {
+    // Preemptible, the IRQs stay enabled while the pages are cleared
+    c_page_zero_refill();
     asm("wfi");
+#ifdef CONFIG_PROF
+    // The idle task runs in SVC mode, it can call into the kernel directly
+    if (c_systick_get() - last_dump >= PROF_DUMP_TICKS) {
+      last_dump = c_systick_get();
+      c_prof_dump();
+    }
+#endif
+#ifdef CONFIG_LATENCY
+    if (c_systick_get() - last_report >= LAT_REPORT_TICKS) {
+      last_report = c_systick_get();
+      c_lat_report(0);
+    }
+#endif
+#ifdef CONFIG_STACK_REPORT
+    if (c_systick_get() - last_stack_report >= STACK_REPORT_TICKS) {
+      last_stack_report = c_systick_get();
+      c_stack_report();
+    }
+#endif
   }
 }
 
 __attribute__((section(".task1.rodata"))) const char str_task1[] =
     "[TASK1] first execution";
+__attribute__((section(".task1.rodata"))) const char str_task1_name[] =
+    "task1";
+// Per array, the STREAM footprint of 0x4000 still fits the 64KB RAREA
+__attribute__((section(".task1.rodata"))) const uint32_t task1_bench_sizes[] = {
+    0x1000, 0x4000, 0x10000, 0x40000};
 // #define __TASK1_RAREA_START 0x70A00000
 // #define __TASK1_RAREA_SIZE 0x10000
 __attribute__((section(".task1.text"))) void task1() {
@@ -23,32 +137,29 @@ __attribute__((section(".task1.text"))) void task1() {
 
   asm("swi #0x1");
 
-  uint32_t *addr = (uint32_t *)&_TASK1_RAREA_START_VMA;
-  uint32_t size_in_bytes = TASK2_RAREA_SIZE_B;
-  uint32_t num_words = size_in_bytes / sizeof(uint32_t);
-  uint32_t temp_original;
+  _membench_cfg_t cfg;
+  cfg.name = str_task1_name;
+  cfg.rarea = (uint32_t *)&_TASK1_RAREA_START_VMA;
+  cfg.rarea_size = TASK1_RAREA_SIZE_B;
+  cfg.sizes = task1_bench_sizes;
+  cfg.size_count = sizeof(task1_bench_sizes) / sizeof(task1_bench_sizes[0]);
+  membench_run(&cfg);
 
+  // Done, sleeps on a word nobody wakes
+  uint32_t idle = 0;
   while (1) {
-    for (uint32_t i = 0; i < num_words; i++) {
-      // Save original
-      temp_original = addr[i];
-
-      // Write new value
-      addr[i] = 0x55AA55AA;
-
-      // Verify
-      if (addr[i] != 0x55AA55AA) {
-        // Here there should be an error
-      }
-
-      // Restore
-      addr[i] = temp_original;
-    }
+    SYSCALL3(SYS_FUTEX_WAIT, &idle, 0, 0);
   }
 }
 
 __attribute__((section(".task2.rodata"))) const char str_task2[] =
     "[TASK2] first execution";
+__attribute__((section(".task2.rodata"))) const char str_task2_dma[] =
+    "[TASK2] written to UART0 by the DMA controller\n";
+__attribute__((section(".task2.rodata"))) const char str_task2_name[] =
+    "task2";
+__attribute__((section(".task2.rodata"))) const uint32_t task2_bench_sizes[] = {
+    0x2000, 0x8000, 0x20000};
 // #define __TASK2_RAREA_START 0x70A10000
 // #define __TASK2_RAREA_SIZE 0x10000
 __attribute__((section(".task2.text"))) void task2() {
@@ -58,17 +169,40 @@ __attribute__((section(".task2.text"))) void task2() {
   // c_log_info(str_task2);
 
   asm("swi #0x2");
+  // The write and a one tick sleep go in with a single system call, which
+  // returns once both completed. The other tasks keep running meanwhile.
+  _uring_t *ring = (_uring_t *)SYSCALL1(SYS_URING_SETUP, 0);
+  if ((uint32_t)ring != VM_MAP_FAILED) {
+    volatile _uring_sqe_t *sqe = uring_get_sqe(ring);
+    sqe->op = URING_OP_WRITE;
+    sqe->arg[0] = (uint32_t)str_task2_dma;
+    sqe->arg[1] = sizeof(str_task2_dma) - 1;
+    sqe->user_data = 0;
+    uring_sqe_commit(ring);
+    sqe = uring_get_sqe(ring);
+    sqe->op = URING_OP_SLEEP;
+    sqe->arg[0] = 1;
+    sqe->user_data = 1;
+    uring_sqe_commit(ring);
+    uring_enter(2);
+    while (uring_peek_cqe(ring) != NULL) {
+      uring_cqe_seen(ring);
+    }
+  } else {
+    SYSCALL2(SYS_UART_WRITE, str_task2_dma, sizeof(str_task2_dma) - 1);
+  }
 
-  uint32_t *addr = (uint32_t *)&_TASK2_RAREA_START_VMA;
-  uint32_t size_in_bytes = TASK2_RAREA_SIZE_B;
-  uint32_t num_words = size_in_bytes / sizeof(uint32_t);
+  _membench_cfg_t cfg;
+  cfg.name = str_task2_name;
+  cfg.rarea = (uint32_t *)&_TASK2_RAREA_START_VMA;
+  cfg.rarea_size = TASK2_RAREA_SIZE_B;
+  cfg.sizes = task2_bench_sizes;
+  cfg.size_count = sizeof(task2_bench_sizes) / sizeof(task2_bench_sizes[0]);
+  membench_run(&cfg);
 
+  // Done, sleeps on a word nobody wakes
+  uint32_t idle = 0;
   while (1) {
-    for (uint32_t i = 0; i < num_words; i++) {
-
-      uint32_t val = addr[i];
-
-      addr[i] = ~val;
-    }
+    SYSCALL3(SYS_FUTEX_WAIT, &idle, 0, 0);
   }
 }
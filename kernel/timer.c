@@ -1,5 +1,6 @@
 #include "inc/timer.h"
 
+#ifdef BOARD_TIMER_SP804
 __attribute__((section(".kernel.text"))) void c_timer_init() {
   _timer_t *const TIMER0 = (_timer_t *)TIMER0_ADDR;
 
@@ -7,7 +8,7 @@ __attribute__((section(".kernel.text"))) void c_timer_init() {
   // which the counter is to decrement. This is the value used to reload the
   // counter when Periodic mode is enabled, and the current count reaches zero.
   // Load with 65536 (decimal)
-  TIMER0->Timer1Load = 0x00010000;
+  TIMER0->Timer1Load = TIMER_TICK_LOAD;
   // Set to 32-bit counter
   TIMER0->Timer1Ctrl = 0x00000002;
   // Timer in periodic mode
@@ -17,3 +18,17 @@ __attribute__((section(".kernel.text"))) void c_timer_init() {
   // Timer Enabled
   TIMER0->Timer1Ctrl |= CTRL_IRQ_ENABLE;
 }
+#endif
+
+#ifdef BOARD_TIMER_A9
+__attribute__((section(".kernel.text"))) void c_timer_init() {
+  _ptimer_t *const PTIMER = (_ptimer_t *)PTIMER_ADDR;
+
+  PTIMER->Control = 0;
+  PTIMER->IntStatus = 0x1;
+  // Auto-reload makes it periodic, reloading Load at zero
+  PTIMER->Load = TIMER_TICK_LOAD;
+  PTIMER->Control = A9_TIMER_PRESCALER(TIMER_PRESCALER) | A9_TIMER_IRQ_ENABLE |
+                    A9_TIMER_AUTO_RELOAD | A9_TIMER_ENABLE;
+}
+#endif
@@ -0,0 +1,110 @@
+#include "inc/trace.h"
+#include "inc/clock.h"
+#include "inc/irq.h"
+#include "inc/uart.h"
+
+// ARM encodings of the two states of a tracepoint
+#define TRACE_INSN_NOP 0xE320F000
+#define TRACE_INSN_BL 0xEB000000
+// bl reaches +-32MB, relative to its own address + 8
+#define TRACE_BL_OFFSET(site, target)                                          \
+  ((((uint32_t)(target) - ((uint32_t)(site) + 8)) >> 2) & 0x00FFFFFF)
+
+// linker/mmap.ld
+extern const _tracepoint_t __tracepoints_start[];
+extern const _tracepoint_t __tracepoints_end[];
+// core/trace.s
+extern void _trace_entry(void);
+
+static uint32_t trace_mask = 0;
+static _trace_event_t trace_ring[TRACE_EVENTS];
+static uint32_t trace_next = 0;  // Next slot written
+static uint32_t trace_count = 0; // Events in the ring
+
+// Writes the instruction and makes the I-side see it: D-cache clean to the
+// point of unification, then I-cache and branch predictor invalidation
+__attribute__((section(".kernel.text"))) static void trace_patch(uint32_t site,
+                                                                 uint32_t insn) {
+  *(volatile uint32_t *)site = insn;
+  asm volatile("mcr p15, 0, %0, c7, c11, 1\n\t" // DCCMVAU
+               "dsb\n\t"
+               "mcr p15, 0, %0, c7, c5, 1\n\t" // ICIMVAU
+               "mcr p15, 0, %0, c7, c5, 7\n\t" // BPIMVA
+               "dsb\n\t"
+               "isb" ::"r"(site)
+               : "memory");
+}
+
+__attribute__((section(".kernel.text"))) uint32_t
+c_trace_enable(uint32_t mask) {
+  uint32_t cpsr = irq_save();
+  uint32_t prev = trace_mask;
+
+  mask &= TRACE_ALL;
+  for (const _tracepoint_t *tp = __tracepoints_start; tp < __tracepoints_end;
+       tp++) {
+    if (((mask ^ prev) & (1u << tp->id)) == 0) {
+      continue;
+    }
+    if (mask & (1u << tp->id)) {
+      trace_patch(tp->site,
+                  TRACE_INSN_BL | TRACE_BL_OFFSET(tp->site, _trace_entry));
+    } else {
+      trace_patch(tp->site, TRACE_INSN_NOP);
+    }
+  }
+  trace_mask = mask;
+  irq_restore(cpsr);
+  return prev;
+}
+
+// Id of the tracepoint at `site`, the table is short
+__attribute__((section(".kernel.text"))) static uint32_t
+trace_site_id(uint32_t site) {
+  for (const _tracepoint_t *tp = __tracepoints_start; tp < __tracepoints_end;
+       tp++) {
+    if (tp->site == site) {
+      return tp->id;
+    }
+  }
+  return TRACE_IDS;
+}
+
+// Runs with the registers of the traced function saved, from any mode
+__attribute__((section(".kernel.text"))) void c_trace_hit(uint32_t arg,
+                                                          uint32_t site) {
+  uint32_t cpsr = irq_save();
+  _trace_event_t *event = &trace_ring[trace_next];
+  event->time_us = (uint32_t)clock_now_us();
+  event->id = trace_site_id(site);
+  event->arg = arg;
+  event->site = site;
+  trace_next = (trace_next + 1) % TRACE_EVENTS;
+  if (trace_count < TRACE_EVENTS) {
+    trace_count++;
+  }
+  irq_restore(cpsr);
+}
+
+// IRQs stay masked while the ring is printed, so it is not written meanwhile
+__attribute__((section(".kernel.text"))) void c_trace_dump(void) {
+  uint32_t cpsr = irq_save();
+  uint32_t slot = (trace_next + TRACE_EVENTS - trace_count) % TRACE_EVENTS;
+
+  for (uint32_t i = 0; i < trace_count; i++) {
+    const _trace_event_t *event = &trace_ring[slot];
+    c_puts("TRACE ");
+    c_puts_hex(event->time_us);
+    c_putchar(' ');
+    c_puts_hex(event->id);
+    c_putchar(' ');
+    c_puts_hex(event->arg);
+    c_putchar(' ');
+    c_puts_hex(event->site);
+    c_putchar('\n');
+    slot = (slot + 1) % TRACE_EVENTS;
+  }
+  trace_next = 0;
+  trace_count = 0;
+  irq_restore(cpsr);
+}
@@ -1,5 +1,6 @@
 #include "inc/uart.h"
 
+#ifdef BOARD_UART_PL011
 __attribute__((section(".text"))) void c_UART0_init() {
   _uart_t *const UART0 = (_uart_t *)UART0_ADDR;
 
@@ -36,6 +37,32 @@ __attribute__((section(".text"))) void c_putchar(char c) {
   }
   UART0->DR = c;
 }
+#endif
+
+#ifdef BOARD_UART_CDNS
+__attribute__((section(".text"))) void c_UART0_init() {
+  _uart_t *const UART0 = (_uart_t *)UART0_ADDR;
+
+  UART0->CR = CDNS_CR_TX_DIS | CDNS_CR_RX_DIS;
+  UART0->MR = CDNS_MR_8N1;
+  // Set baud rate to 115200:
+  // Zynq-7000 TRM 19.2.3, baud = UART_REF_CLK / (BAUDGEN * (BAUDDIV + 1))
+  // With the 100MHz reference clock: 100E6 / (124 * 7) = 115207
+  UART0->BAUDGEN = 124;
+  UART0->BAUDDIV = 6;
+  // Reset both FIFOs, then enable
+  UART0->CR = CDNS_CR_TXRST | CDNS_CR_RXRST | CDNS_CR_TX_DIS | CDNS_CR_RX_DIS;
+  UART0->CR = CDNS_CR_TX_EN | CDNS_CR_RX_EN;
+}
+
+__attribute__((section(".text"))) void c_putchar(char c) {
+  _uart_t *const UART0 = (_uart_t *)UART0_ADDR;
+
+  while ((UART0->SR & CDNS_SR_TXFULL) != 0) {
+  }
+  UART0->FIFO = c;
+}
+#endif
 
 __attribute__((section(".text"))) void c_puts(const char *s) {
   while (*s) {
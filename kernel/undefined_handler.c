@@ -1,8 +1,16 @@
 #include "../sys/inc/logger.h"
+#include "inc/vfp.h"
 
+// Returns 1 if the instruction at pc has to be retried
 __attribute__((section(".text._undefined_handler"))) uint32_t
-c_undefined_handler() {
-  c_log_error("Undefined Handler Exception");
+c_undefined_handler(uint32_t *pc) {
+  // Lazy FP context switch
+  if (c_vfp_trap(*pc)) {
+    return 1;
+  }
+
+  c_log_error("Undefined Handler Exception at address:");
+  c_puts_hex((uint32_t)pc);
   c_putchar('\n');
 
   while (1) {
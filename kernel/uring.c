@@ -0,0 +1,289 @@
+#include "inc/uring.h"
+#include "inc/dma.h"
+#include "inc/futex.h"
+#include "inc/irq.h"
+#include "inc/mmu.h"
+#include "inc/page.h"
+#include "inc/swtimer.h"
+
+extern mmu_tables_t mmu_tables[MAX_TASKS];
+
+struct _uring_ctx;
+
+// An entry that completes after its system call returned (write, sleep)
+typedef struct {
+  _swtimer_t timer;
+  struct _uring_ctx *ctx;
+  uint32_t user_data;
+  int32_t res; // Result on success
+  uint32_t busy;
+} _uring_req_t;
+
+typedef struct _uring_ctx {
+  _uring_t *ring; // The shared page, 1:1 in the kernel heap. NULL until setup
+  uint32_t flags;
+  // Kernel copies of its indices, the task can write the shared ones
+  uint32_t sq_head;
+  uint32_t cq_tail;
+  // Consumed entries not completed yet, their CQ slots are reserved
+  uint32_t inflight;
+  // Completions the blocked task waits for, 0 if it does not wait
+  uint32_t wait;
+  _uring_req_t reqs[URING_SQ_ENTRIES];
+} _uring_ctx_t;
+
+static _uring_ctx_t uring_ctx[MAX_TASKS];
+
+// Free CQ slots that no consumed entry has reserved
+static inline uint32_t uring_cq_room(_uring_ctx_t *ctx) {
+  uint32_t used = ctx->cq_tail - ctx->ring->cq_head;
+  // A head the task moved past the tail counts as a full queue
+  if (used > URING_CQ_ENTRIES) {
+    used = URING_CQ_ENTRIES;
+  }
+  if (used + ctx->inflight >= URING_CQ_ENTRIES) {
+    return 0;
+  }
+  return URING_CQ_ENTRIES - used - ctx->inflight;
+}
+
+static inline _uring_req_t *uring_req_get(_uring_ctx_t *ctx) {
+  for (uint32_t i = 0; i < URING_SQ_ENTRIES; i++) {
+    if (!ctx->reqs[i].busy) {
+      return &ctx->reqs[i];
+    }
+  }
+  return NULL;
+}
+
+// Posts the completion of a consumed entry, from any context
+__attribute__((section(".kernel.text"))) static void
+uring_complete(_uring_ctx_t *ctx, uint32_t user_data, int32_t res) {
+  uint32_t cpsr = irq_save();
+  _uring_t *ring = ctx->ring;
+  volatile _uring_cqe_t *cqe = &ring->cq[ctx->cq_tail & (URING_CQ_ENTRIES - 1)];
+
+  cqe->user_data = user_data;
+  cqe->res = res;
+  // The entry has to be visible before the tail that publishes it
+  atomic_barrier();
+  ctx->cq_tail++;
+  ring->cq_tail = ctx->cq_tail;
+  ctx->inflight--;
+
+  if (ctx->wait != 0 &&
+      (ctx->cq_tail - ring->cq_head >= ctx->wait || ctx->inflight == 0)) {
+    ctx->wait = 0;
+    c_task_wake((uintptr_t)ctx, 1);
+  }
+  irq_restore(cpsr);
+}
+
+// DMA callback, runs in the kworker
+__attribute__((section(".kernel.text"))) static void
+uring_write_done(void *arg, int32_t status) {
+  _uring_req_t *req = (_uring_req_t *)arg;
+
+  uint32_t cpsr = irq_save();
+  uring_complete(req->ctx, req->user_data,
+                 status == DMA_SUCCESS ? req->res : status);
+  req->busy = 0;
+  irq_restore(cpsr);
+}
+
+// Software timer callback, runs in the kworker
+__attribute__((section(".kernel.text"))) static void
+uring_sleep_done(void *arg) {
+  _uring_req_t *req = (_uring_req_t *)arg;
+
+  uint32_t cpsr = irq_save();
+  uring_complete(req->ctx, req->user_data, req->res);
+  req->busy = 0;
+  irq_restore(cpsr);
+}
+
+// Runs one consumed entry on the current task's tables. `req` is only set
+// for the ops that complete later.
+__attribute__((section(".kernel.text"))) static void
+uring_submit(_uring_ctx_t *ctx, _uring_req_t *req, uint32_t op, uint32_t arg0,
+             uint32_t arg1, uint32_t user_data) {
+  int32_t ret;
+
+  switch (op) {
+  case URING_OP_NOP:
+    uring_complete(ctx, user_data, 0);
+    return;
+
+  case URING_OP_WRITE:
+    req->user_data = user_data;
+    req->res = arg1;
+    req->busy = 1;
+    ret = c_dma_uart_write_user_async((const void *)arg0, arg1,
+                                      uring_write_done, req);
+    if (ret >= 0) {
+      return;
+    }
+    req->busy = 0;
+    // No controller, SYS_UART_WRITE polls the buffer out
+    if (ret == DMA_ERROR_NODEV) {
+      ret = c_dma_uart_write((const void *)arg0, arg1);
+    }
+    uring_complete(ctx, user_data, ret);
+    return;
+
+  case URING_OP_SLEEP:
+    req->user_data = user_data;
+    req->res = 0;
+    req->busy = 1;
+    c_swtimer_add(&req->timer, arg0);
+    return;
+
+  case URING_OP_FUTEX_WAKE:
+    uring_complete(ctx, user_data,
+                   c_futex_wake((volatile uint32_t *)arg0, arg1));
+    return;
+
+  case URING_OP_MMAP:
+    uring_complete(ctx, user_data, c_vm_mmap(arg0));
+    return;
+
+  default:
+    uring_complete(ctx, user_data, URING_ERROR_OP);
+    return;
+  }
+}
+
+// Whether the timer tick may run the op: it must not block, nor take time
+// that grows with its arguments. The polled write of boards without DMA and
+// SYS_MMAP, which clears the mapping, wait for SYS_URING_ENTER.
+static inline uint32_t uring_op_tick_safe(uint32_t op) {
+  switch (op) {
+  case URING_OP_NOP:
+  case URING_OP_SLEEP:
+  case URING_OP_FUTEX_WAKE:
+#ifdef BOARD_HAS_DMA
+  case URING_OP_WRITE:
+#endif
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Consumes the queued entries, with IRQs masked. Each field of an entry is
+// read once, the task may rewrite it meanwhile. From the tick it stops at
+// the first entry that is not tick safe, which keeps them in order.
+__attribute__((section(".kernel.text"))) static uint32_t
+uring_drain(_uring_ctx_t *ctx, uint32_t tick) {
+  _uring_t *ring = ctx->ring;
+  uint32_t tail = ring->sq_tail;
+  uint32_t consumed = 0;
+
+  // Further than a full queue away, the tail is garbage
+  if (tail - ctx->sq_head > URING_SQ_ENTRIES) {
+    return 0;
+  }
+  while (ctx->sq_head != tail && uring_cq_room(ctx) > 0) {
+    volatile _uring_sqe_t *sqe =
+        &ring->sq[ctx->sq_head & (URING_SQ_ENTRIES - 1)];
+    uint32_t op = sqe->op;
+    uint32_t arg0 = sqe->arg[0];
+    uint32_t arg1 = sqe->arg[1];
+    uint32_t user_data = sqe->user_data;
+
+    if (tick && !uring_op_tick_safe(op)) {
+      break;
+    }
+    _uring_req_t *req = NULL;
+    if (op == URING_OP_WRITE || op == URING_OP_SLEEP) {
+      req = uring_req_get(ctx);
+      // Left queued until one completes
+      if (req == NULL) {
+        break;
+      }
+    }
+    ctx->sq_head++;
+    ctx->inflight++;
+    consumed++;
+    uring_submit(ctx, req, op, arg0, arg1, user_data);
+  }
+  ring->sq_head = ctx->sq_head;
+  return consumed;
+}
+
+// The ring page comes from the kernel heap, so the DMA and timer callbacks
+// reach it from the kworker's tables too
+__attribute__((section(".kernel.text"))) uint32_t
+c_uring_setup(uint32_t flags) {
+  _task_t *task = c_task_current();
+  _uring_ctx_t *ctx = &uring_ctx[task->id];
+
+  if (task->flags & TASK_KERNEL) {
+    return VM_MAP_FAILED;
+  }
+  if (ctx->ring != NULL) {
+    ctx->flags = flags;
+    return URING_VMA;
+  }
+
+  _uring_t *ring = (_uring_t *)c_page_alloc(1);
+  if (ring == NULL) {
+    return VM_MAP_FAILED;
+  }
+  clear_memory((void *)ring, PAGE_SIZE);
+  _mmu_map_t map;
+  map.va = URING_VMA;
+  map.pa = (uint32_t)ring;
+  map.size = PAGE_SIZE;
+  map.flags = L2_USR_FLAGS | L2_XN;
+  if (c_mmu_map_batch(&mmu_tables[task->id], &map, 1) != PAGING_SUCCESS) {
+    c_page_free((void *)ring, 1);
+    return VM_MAP_FAILED;
+  }
+
+  ctx->flags = flags;
+  ctx->sq_head = 0;
+  ctx->cq_tail = 0;
+  ctx->inflight = 0;
+  ctx->wait = 0;
+  for (uint32_t i = 0; i < URING_SQ_ENTRIES; i++) {
+    _uring_req_t *req = &ctx->reqs[i];
+    c_swtimer_init(&req->timer, uring_sleep_done, req);
+    req->ctx = ctx;
+    req->busy = 0;
+  }
+  ctx->ring = ring;
+  return URING_VMA;
+}
+
+// Called from the SWI handler with IRQs masked, so no completion can be
+// posted between the check and the block
+__attribute__((section(".kernel.text"))) uint32_t
+c_uring_enter(uint32_t min_complete) {
+  _uring_ctx_t *ctx = &uring_ctx[c_task_current()->id];
+
+  if (ctx->ring == NULL) {
+    return (uint32_t)URING_ERROR_NORING;
+  }
+  uint32_t consumed = uring_drain(ctx, 0);
+
+  if (min_complete > URING_CQ_ENTRIES) {
+    min_complete = URING_CQ_ENTRIES;
+  }
+  if (ctx->inflight > 0 && ctx->cq_tail - ctx->ring->cq_head < min_complete) {
+    ctx->wait = min_complete;
+    // The ring's context is the wait key, kernel memory is never a futex key
+    c_task_block((uintptr_t)ctx, SCHED_NO_HINT);
+  }
+  return consumed;
+}
+
+// IRQ mode with IRQs masked, the interrupted task's tables are active.
+// Kernel tasks never have a ring.
+__attribute__((section(".kernel.text"))) void c_uring_poll(void) {
+  _uring_ctx_t *ctx = &uring_ctx[c_task_current()->id];
+
+  if (ctx->ring != NULL && (ctx->flags & URING_SQPOLL)) {
+    uring_drain(ctx, 1);
+  }
+}
@@ -0,0 +1,75 @@
+#include "inc/vfp.h"
+#include "../sys/inc/logger.h"
+
+// Lazy FP context switching
+// The VFP registers belong to one task at a time, vfp_owner. Every other task
+// runs with FPEXC.EN cleared, so its first VFP/NEON instruction traps into the
+// undefined handler, which moves the registers to it and retries the
+// instruction. Tasks that never use FP never pay for the D registers.
+static _vfp_ctx_t vfp_ctx[MAX_TASKS] __attribute__((aligned(8)));
+static int32_t vfp_owner = -1;
+
+__attribute__((section(".kernel.text"))) void c_vfp_init(void) {
+  // Enable cp10 and cp11 access for all modes
+  // # Following:
+  // https://developer.arm.com/documentation/ddi0406/c/System-Level-Architecture/System-Control-Registers-in-a-VMSA-implementation/VMSA-System-control-registers-descriptions--in-register-order/CPACR--Coprocessor-Access-Control-Register--VMSA
+  uint32_t cpacr;
+  __asm__ volatile("mrc p15, 0, %0, c1, c0, 2" : "=r"(cpacr));
+  cpacr |= CPACR_CP10_CP11_FULL;
+  __asm__ volatile("mcr p15, 0, %0, c1, c0, 2\n"
+                   "isb\n" ::"r"(cpacr));
+
+  // FP stays disabled until a task uses it
+  _vfp_disable();
+}
+
+// Called by the scheduler on every task switch.
+__attribute__((section(".kernel.text"))) void
+c_vfp_switch(_task_id_t next_id) {
+  if ((int32_t)next_id == vfp_owner) {
+    _vfp_enable();
+  } else {
+    _vfp_disable();
+  }
+}
+
+// VFP and Advanced SIMD instruction encodings (ARM state)
+// https://developer.arm.com/documentation/ddi0406/c/Application-Level-Architecture/ARM-Instruction-Set-Encoding/ARM-instruction-set-encoding
+static inline uint32_t is_vfp_instr(uint32_t instr) {
+  // Advanced SIMD data processing
+  if ((instr & 0xFE000000) == 0xF2000000) {
+    return 1;
+  }
+  // Advanced SIMD element or structure load/store
+  if ((instr & 0xFF100000) == 0xF4000000) {
+    return 1;
+  }
+  // Coprocessor instructions on cp10/cp11 (VFP, VMRS/VMSR, VLDM/VSTM...)
+  if ((instr & 0x0C000000) == 0x0C000000 &&
+      (instr & 0x00000E00) == 0x00000A00) {
+    return 1;
+  }
+  return 0;
+}
+
+// Returns 1 if the trapped instruction has to be retried.
+__attribute__((section(".kernel.text"))) uint32_t c_vfp_trap(uint32_t instr) {
+  if (!is_vfp_instr(instr)) {
+    return 0;
+  }
+  // FP already enabled: the instruction is really undefined
+  if (_vfp_is_enabled()) {
+    return 0;
+  }
+
+  _vfp_enable();
+  _task_id_t id = c_task_current()->id;
+  if ((int32_t)id != vfp_owner) {
+    if (vfp_owner >= 0) {
+      _vfp_save(&vfp_ctx[vfp_owner]);
+    }
+    _vfp_restore(&vfp_ctx[id]);
+    vfp_owner = id;
+  }
+  return 1;
+}
@@ -0,0 +1,317 @@
+#include "inc/vm.h"
+#include "../sys/inc/logger.h"
+#include "inc/loader.h"
+#include "inc/mmu.h"
+#include "inc/page.h"
+#include "inc/sched.h"
+#include "inc/uring.h"
+#include <stddef.h>
+
+extern mmu_tables_t mmu_tables[MAX_TASKS];
+
+#define PAGE_ALIGN_UP(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+// Physically contiguous runs handed to c_mmu_map_batch() at once
+#define VM_MAP_BATCH 8
+
+// Pages shared copy-on-write are only freed by their last user
+__attribute__((section(".kernel.text"))) static void
+vm_release_page(uint32_t pa) {
+  c_page_unref(&page_zone_user, pa);
+}
+
+// Maps the runs, on failure their pages go back to the pool
+__attribute__((section(".kernel.text"))) static int32_t
+vm_map_runs(mmu_tables_t *tables, const _mmu_map_t *maps, uint32_t count) {
+  int32_t ret = c_mmu_map_batch(tables, maps, count);
+  if (ret != PAGING_SUCCESS) {
+    for (uint32_t i = 0; i < count; i++) {
+      c_page_zone_free(&page_zone_user, (void *)maps[i].pa,
+                       maps[i].size >> PAGE_SHIFT);
+    }
+  }
+  return ret;
+}
+
+// Backs [va, va + size) with pages from the user pool. Pages come from the
+// zero pool while it has some, the rest are cleared here: the task's system
+// call runs with its tables active, so through their new user mapping.
+__attribute__((section(".kernel.text"))) static int32_t
+vm_map_pages(_task_t *task, uint32_t va, uint32_t size) {
+  mmu_tables_t *tables = &mmu_tables[task->id];
+  _mmu_map_t maps[VM_MAP_BATCH];
+  uint32_t count = 0;
+  // [va, va + zeroed) came from the zero pool
+  uint32_t zeroed = 0;
+
+  // Checked up front so a failure does not leave part of the range mapped.
+  // The window has a single L2 table, only its first page can fail on it.
+  if ((size >> PAGE_SHIFT) > c_page_user_available()) {
+    return VM_ERROR_NO_MEMORY;
+  }
+  for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+    uint32_t page = 0;
+    if (zeroed == off) {
+      page = c_page_zero_get();
+      if (page != 0) {
+        zeroed += PAGE_SIZE;
+      }
+    }
+    if (page == 0) {
+      page = (uint32_t)c_page_zone_alloc(&page_zone_user, 1);
+    }
+    if (page == 0) {
+      // Drops the pending runs and the batches mapped before them
+      for (uint32_t i = 0; i < count; i++) {
+        c_page_zone_free(&page_zone_user, (void *)maps[i].pa,
+                         maps[i].size >> PAGE_SHIFT);
+      }
+      c_mmu_unmap_range(tables, va, off, vm_release_page);
+      return VM_ERROR_NO_MEMORY;
+    }
+    // Pages that follow the previous run extend it
+    if (count > 0 && maps[count - 1].pa + maps[count - 1].size == page) {
+      maps[count - 1].size += PAGE_SIZE;
+      continue;
+    }
+    if (count == VM_MAP_BATCH) {
+      int32_t ret = vm_map_runs(tables, maps, count);
+      if (ret != PAGING_SUCCESS) {
+        c_page_zone_free(&page_zone_user, (void *)page, 1);
+        // The range was unmapped, this only drops the earlier batches
+        c_mmu_unmap_range(tables, va, size, vm_release_page);
+        return ret;
+      }
+      count = 0;
+    }
+    maps[count].va = va + off;
+    maps[count].pa = page;
+    maps[count].size = PAGE_SIZE;
+    maps[count].flags = L2_USR_FLAGS | L2_XN;
+    count++;
+  }
+  int32_t ret = vm_map_runs(tables, maps, count);
+  if (ret != PAGING_SUCCESS) {
+    c_mmu_unmap_range(tables, va, size, vm_release_page);
+    return ret;
+  }
+  clear_memory((void *)(va + zeroed), size - zeroed);
+  return PAGING_SUCCESS;
+}
+
+__attribute__((section(".kernel.text"))) uint32_t c_vm_brk(uint32_t addr) {
+  _task_t *task = c_task_current();
+
+  if (addr == 0) {
+    return task->heap_brk;
+  }
+  if (addr < TASK_HEAP_VMA || addr > task->mmap_base) {
+    return task->heap_brk;
+  }
+
+  // Shrinking gives the whole pages above the new break back to the pool
+  uint32_t end = PAGE_ALIGN_UP(addr);
+  if (end < task->heap_mapped) {
+    c_mmu_unmap_range(&mmu_tables[task->id], end, task->heap_mapped - end,
+                      vm_release_page);
+    task->heap_mapped = end;
+  } else if (end > task->heap_mapped) {
+    if (vm_map_pages(task, task->heap_mapped, end - task->heap_mapped) !=
+        PAGING_SUCCESS) {
+      c_log_warn("brk: out of memory");
+      return task->heap_brk;
+    }
+    task->heap_mapped = end;
+  }
+  task->heap_brk = addr;
+  return addr;
+}
+
+__attribute__((section(".kernel.text"))) uint32_t c_vm_mmap(uint32_t size) {
+  _task_t *task = c_task_current();
+
+  size = PAGE_ALIGN_UP(size);
+  if (size == 0 || size > task->mmap_base - task->heap_mapped) {
+    return VM_MAP_FAILED;
+  }
+  uint32_t va = task->mmap_base - size;
+  if (vm_map_pages(task, va, size) != PAGING_SUCCESS) {
+    c_log_warn("mmap: out of memory");
+    return VM_MAP_FAILED;
+  }
+  task->mmap_base = va;
+  return va;
+}
+
+// Bounce buffer for the copy-on-write copies, from the kernel heap
+static uint32_t *vm_cow_bounce = NULL;
+
+// Copies the parent's tables into the child's, pointing the child's L1
+// entries at its own L2 tables.
+__attribute__((section(".kernel.text"))) static void
+vm_copy_tables(mmu_tables_t *src, mmu_tables_t *dst) {
+  for (uint32_t i = 0; i < L1_ENTRIES; i++) {
+    uint32_t l1 = src->l1_table[i];
+    if ((l1 & 0x3) == L1_TYPE_COARSE_TABLE) {
+      // Index of the L2 table, L2_SIZE is 1KB
+      uint32_t t = ((l1 & 0xFFFFFC00) - (uint32_t)src->l2_tables) >> 10;
+      l1 = (uint32_t)dst->l2_tables[t] | L1_TYPE_COARSE_TABLE;
+    }
+    dst->l1_table[i] = l1;
+  }
+  for (uint32_t t = 0; t < src->next_l2_table; t++) {
+    for (uint32_t j = 0; j < L2_ENTRIES; j++) {
+      dst->l2_tables[t][j] = src->l2_tables[t][j];
+    }
+  }
+  dst->next_l2_table = src->next_l2_table;
+}
+
+// Whether the task may write va: its heap window or a SEG_WRITE segment
+__attribute__((section(".kernel.text"))) static uint32_t
+vm_writable(const _task_t *task, uint32_t va) {
+  const _task_image_t *image = task->image;
+
+  if (va - TASK_HEAP_VMA < TASK_HEAP_SIZE) {
+    return 1;
+  }
+  for (uint32_t i = 0; i < image->segment_count; i++) {
+    const _task_segment_t *seg = &image->segments[i];
+    if ((seg->flags & SEG_WRITE) && va - seg->vma < seg->size) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Runs in the parent's system call, with its tables active.
+__attribute__((section(".kernel.text"))) int32_t c_vm_clone(_task_t *parent,
+                                                            _task_t *child) {
+  mmu_tables_t *ptables = &mmu_tables[parent->id];
+  mmu_tables_t *ctables = &mmu_tables[child->id];
+
+  uint32_t stack = (uint32_t)c_page_zone_alloc(
+      &page_zone_user, parent->stack_size >> PAGE_SHIFT);
+  if (stack == 0) {
+    return VM_ERROR_NO_MEMORY;
+  }
+
+  vm_copy_tables(ptables, ctables);
+
+  // The child's own pages go in first, so a failure leaves the parent's
+  // tables and the page counts untouched
+  c_mmu_unmap_range(ctables, parent->stack_base, parent->stack_size, NULL);
+  c_mmu_unmap_range(ctables, URING_VMA, PAGE_SIZE, NULL);
+  _mmu_map_t map;
+  map.va = parent->stack_base;
+  map.pa = stack;
+  map.size = parent->stack_size;
+  map.flags = c_loader_l2_flags(SEG_USER | SEG_WRITE);
+  int32_t ret = c_mmu_map_batch(ctables, &map, 1);
+  if (ret != PAGING_SUCCESS) {
+    c_page_zone_free(&page_zone_user, (void *)stack,
+                     parent->stack_size >> PAGE_SHIFT);
+    return ret;
+  }
+
+  for (uint32_t i = 0; i < L1_ENTRIES; i++) {
+    if ((ptables->l1_table[i] & 0x3) != L1_TYPE_COARSE_TABLE) {
+      continue;
+    }
+    uint32_t *pl2 = (uint32_t *)(ptables->l1_table[i] & 0xFFFFFC00);
+    uint32_t *cl2 = (uint32_t *)(ctables->l1_table[i] & 0xFFFFFC00);
+    for (uint32_t j = 0; j < L2_ENTRIES; j++) {
+      uint32_t va = (i << 20) | (j << 12);
+      // Kernel-only pages are the same for every task, the stack was
+      // replaced above and the submission ring stays the parent's
+      if ((pl2[j] & 0x3) == 0 || (pl2[j] & AP1(1)) == 0 ||
+          va - parent->stack_base < parent->stack_size || va == URING_VMA) {
+        continue;
+      }
+      if ((pl2[j] & L2_AP_MASK) == (USR_RW)) {
+        pl2[j] |= AP2(1);
+        cl2[j] = pl2[j];
+      }
+      c_page_ref(&page_zone_user, pl2[j] & 0xFFFFF000);
+    }
+  }
+  // The parent keeps running on these tables
+  mmu_tlb_flush_all();
+
+  child->stack_base = parent->stack_base;
+  child->stack_phy = stack;
+  child->stack_size = parent->stack_size;
+  child->heap_brk = parent->heap_brk;
+  child->heap_mapped = parent->heap_mapped;
+  child->mmap_base = parent->mmap_base;
+  return PAGING_SUCCESS;
+}
+
+// The parent's pages stay read-only, its next write to one finds a single
+// reference and just gets write access back
+__attribute__((section(".kernel.text"))) void c_vm_clone_undo(_task_t *child) {
+  mmu_tables_t *ctables = &mmu_tables[child->id];
+
+  for (uint32_t i = 0; i < L1_ENTRIES; i++) {
+    if ((ctables->l1_table[i] & 0x3) != L1_TYPE_COARSE_TABLE) {
+      continue;
+    }
+    uint32_t *cl2 = (uint32_t *)(ctables->l1_table[i] & 0xFFFFFC00);
+    for (uint32_t j = 0; j < L2_ENTRIES; j++) {
+      if ((cl2[j] & 0x3) == 0 || (cl2[j] & AP1(1)) == 0) {
+        continue;
+      }
+      c_page_unref(&page_zone_user, cl2[j] & 0xFFFFF000);
+      cl2[j] = 0;
+    }
+  }
+}
+
+__attribute__((section(".kernel.text"))) int32_t c_vm_cow_fault(uint32_t addr) {
+  _task_t *task = c_task_current();
+  mmu_tables_t *tables = &mmu_tables[task->id];
+  uint32_t va = addr & ~(PAGE_SIZE - 1);
+
+  uint32_t *entry = c_mmu_l2_entry(tables, va);
+  if (entry == NULL || (*entry & 0x3) == 0 ||
+      (*entry & L2_AP_MASK) != (USR_RO) || !vm_writable(task, va)) {
+    return VM_ERROR_FAULT;
+  }
+  uint32_t pa = *entry & 0xFFFFF000;
+  uint32_t flags = (*entry & 0xFFF) & ~AP2(1);
+
+  // Nobody else maps it any more
+  if (c_page_refs(&page_zone_user, pa) == 1) {
+    return c_mmu_protect_range(tables, va, PAGE_SIZE, flags);
+  }
+
+  if (vm_cow_bounce == NULL) {
+    vm_cow_bounce = c_page_alloc(1);
+  }
+  uint32_t copy = (uint32_t)c_page_zone_alloc(&page_zone_user, 1);
+  if (vm_cow_bounce == NULL || copy == 0) {
+    return VM_ERROR_NO_MEMORY;
+  }
+
+  // The new page is only reachable through va once it is mapped, so the
+  // contents go through the bounce buffer.
+  uint32_t *src = (uint32_t *)va;
+  for (uint32_t i = 0; i < PAGE_SIZE / 4; i++) {
+    vm_cow_bounce[i] = src[i];
+  }
+  c_mmu_unmap_range(tables, va, PAGE_SIZE, vm_release_page);
+  _mmu_map_t map;
+  map.va = va;
+  map.pa = copy;
+  map.size = PAGE_SIZE;
+  map.flags = flags;
+  int32_t ret = c_mmu_map_batch(tables, &map, 1);
+  if (ret != PAGING_SUCCESS) {
+    c_page_zone_free(&page_zone_user, (void *)copy, 1);
+    return ret;
+  }
+  uint32_t *dst = (uint32_t *)va;
+  for (uint32_t i = 0; i < PAGE_SIZE / 4; i++) {
+    dst[i] = vm_cow_bounce[i];
+  }
+  return PAGING_SUCCESS;
+}
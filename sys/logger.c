@@ -1,60 +1,113 @@
 #include "inc/logger.h"
+#include "../kernel/inc/semihost.h"
+
+// Backend, chosen with `make build LOG=uart|semihost|both`
+#if !defined(CONFIG_LOG_UART) && !defined(CONFIG_LOG_SEMIHOST)
+#define CONFIG_LOG_UART
+#endif
+
+__attribute__((section(".kernel.text"))) static void log_puts(const char *s) {
+#ifdef CONFIG_LOG_UART
+  c_puts(s);
+#endif
+#ifdef CONFIG_LOG_SEMIHOST
+  c_semihost_write0(s);
+#endif
+}
+
+__attribute__((section(".kernel.text"))) static void log_putsln(const char *s) {
+  log_puts(s);
+  log_puts("\n");
+}
+
+__attribute__((section(".kernel.text"))) static void log_putchar(char c) {
+  char buf[2];
+  buf[0] = c;
+  buf[1] = '\0';
+  log_puts(buf);
+}
+
+__attribute__((section(".kernel.text"))) static void
+log_puts_hex(uint32_t val) {
+  char buf[11];
+  buf[0] = '0';
+  buf[1] = 'x';
+  for (int i = 0; i < 8; i++) {
+    buf[9 - i] = "0123456789ABCDEF"[val & 0xF];
+    val >>= 4;
+  }
+  buf[10] = '\0';
+  log_puts(buf);
+}
 
 __attribute__((section(".kernel.text"))) void c_log_error(const char *s) {
-  c_puts("\033[1;31m[ERROR] \033[0m");
-  c_putsln(s);
+  log_puts("\033[1;31m[ERROR] \033[0m");
+  log_putsln(s);
 }
 __attribute__((section(".kernel.text"))) void c_log_info(const char *s) {
-  c_puts("\033[1;32m[INFO] \033[0m");
-  c_putsln(s);
+  log_puts("\033[1;32m[INFO] \033[0m");
+  log_putsln(s);
 }
 __attribute__((section(".kernel.text"))) void c_log_warn(const char *s) {
-  c_puts("\033[1;33m[WARN] \033[0m");
-  c_putsln(s);
+  log_puts("\033[1;33m[WARN] \033[0m");
+  log_putsln(s);
 }
 
+// The per-switch and per-page traces are compiled out of BENCH=1 builds: the
+// benchmarks time c_scheduler() and map_region(), not the UART.
 __attribute__((section(".kernel.text"))) void
 c_log_taskswitch(uint8_t task_id) {
-  c_puts("\033[38;5;208m[SWITCH]\033[0m ➡️ ");
+#ifdef CONFIG_BENCH
+  (void)task_id;
+#else
+  log_puts("\033[38;5;208m[SWITCH]\033[0m ➡️ ");
   switch (task_id) {
   case 0:
-    c_puts(" \033[38;5;205m[TASK0]\033[0m ");
-    c_putsln("😀");
+    log_puts(" \033[38;5;205m[TASK0]\033[0m ");
+    log_putsln("😀");
     break;
   case 1:
-    c_puts(" \033[38;5;206m[TASK1]\033[0m ");
-    c_putsln("😁");
+    log_puts(" \033[38;5;206m[TASK1]\033[0m ");
+    log_putsln("😁");
     break;
   case 2:
-    c_puts(" \033[38;5;204m[TASK2]\033[0m ");
-    c_putsln("😂");
+    log_puts(" \033[38;5;204m[TASK2]\033[0m ");
+    log_putsln("😂");
     break;
   default:
+    log_puts(" \033[38;5;207m[TASK");
+    log_putchar('0' + task_id);
+    log_putsln("]\033[0m ");
     break;
   }
+#endif
 }
 
 __attribute__((section(".kernel.text"))) void c_log_mapping(const char *label,
                                                             uint32_t vaddr,
                                                             uint32_t paddr,
                                                             uint32_t size) {
-  c_puts("\033[1;36m");
-  c_puts(label);
-  c_putsln(":\033[0m");
-  c_puts("VA = ");
-  c_puts_hex(vaddr);
-  c_puts(" -> PA = ");
-  c_puts_hex(paddr);
-  c_puts(" (size = ");
-  c_puts_hex(size);
-  c_putsln(" bytes)");
+  log_puts("\033[1;36m");
+  log_puts(label);
+  log_putsln(":\033[0m");
+  log_puts("VA = ");
+  log_puts_hex(vaddr);
+  log_puts(" -> PA = ");
+  log_puts_hex(paddr);
+  log_puts(" (size = ");
+  log_puts_hex(size);
+  log_putsln(" bytes)");
 }
 
 __attribute__((section(".kernel.text"))) void c_log_page(uint32_t vaddr,
                                                          uint32_t paddr) {
-  c_puts("  \033[1;34mMapping Page:\033[0m VA = ");
-  c_puts_hex(vaddr);
-  c_puts(" -> PA = ");
-  c_puts_hex(paddr);
-  c_putsln("");
+#ifdef CONFIG_BENCH
+  (void)vaddr, (void)paddr;
+#else
+  log_puts("  \033[1;34mMapping Page:\033[0m VA = ");
+  log_puts_hex(vaddr);
+  log_puts(" -> PA = ");
+  log_puts_hex(paddr);
+  log_putsln("");
+#endif
 }
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Compare the micro-benchmark results (kernel/bench.c) against a baseline.
+
+Usage: bench_compare.py [--update] [--threshold PCT] <uart capture> <baseline>
+
+The capture holds "BENCH <name> <iterations> <cycles>" lines among the
+regular log output. Benchmarks are compared by cycles per iteration, any of
+them getting slower than the threshold (10% by default) is a regression and
+makes the script exit with 1, and so does a missing baseline file. --update
+writes the capture's results as the new baseline instead.
+"""
+import argparse
+import re
+import sys
+
+BENCH_LINE = re.compile(r"^BENCH (\w+) 0x([0-9A-Fa-f]+) 0x([0-9A-Fa-f]+)\s*$")
+
+
+def parse_results(path):
+    results = {}
+    done = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if line == "BENCH done":
+                done = True
+                continue
+            m = BENCH_LINE.match(line)
+            if m:
+                iterations, cycles = int(m.group(2), 16), int(m.group(3), 16)
+                results[m.group(1)] = cycles / max(iterations, 1)
+    return results, done
+
+
+def load_baseline(path):
+    baseline = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                fields = line.split("#", 1)[0].split()
+                if len(fields) == 2:
+                    baseline[fields[0]] = float(fields[1])
+    except FileNotFoundError:
+        return None
+    return baseline
+
+
+def write_baseline(path, results):
+    with open(path, "w") as f:
+        f.write("# <benchmark> <cycles per iteration>, from `make bench.baseline`\n")
+        for name in sorted(results):
+            f.write("%s %.1f\n" % (name, results[name]))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("capture")
+    parser.add_argument("baseline")
+    parser.add_argument("--update", action="store_true")
+    parser.add_argument("--threshold", type=float, default=10.0)
+    args = parser.parse_args()
+
+    results, done = parse_results(args.capture)
+    if not done:
+        print("error: %s has no complete benchmark run" % args.capture)
+        return 1
+
+    if args.update:
+        write_baseline(args.baseline, results)
+        print("baseline written to %s" % args.baseline)
+        return 0
+
+    baseline = load_baseline(args.baseline)
+    if baseline is None:
+        print("error: no baseline at %s, run `make bench.baseline` on a known"
+              " good tree first" % args.baseline)
+        return 1
+
+    regressions = 0
+    print("%-16s %14s %14s %9s" % ("benchmark", "baseline", "cycles/iter",
+                                    "change"))
+    for name in sorted(results):
+        cur = results[name]
+        base = baseline.get(name)
+        if base is None:
+            print("%-16s %14s %14.1f %9s" % (name, "-", cur, "new"))
+            continue
+        change = (cur - base) * 100.0 / base if base else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        print("%-16s %14.1f %14.1f %+8.1f%%%s" % (name, base, cur, change, mark))
+    for name in sorted(set(baseline) - set(results)):
+        print("%-16s %14.1f %14s %9s  MISSING" % (name, baseline[name], "-", ""))
+        regressions += 1
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
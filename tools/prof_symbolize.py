@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Symbolize the profiler dumps (kernel/prof.c) captured from UART0.
+
+Usage: prof_symbolize.py <uart capture> <obj/image.elf>
+
+The capture can contain regular log output, every dump is found by its
+magic. The last complete dump is reported as a flat profile per task.
+"""
+import bisect
+import struct
+import subprocess
+import sys
+
+PROF_MAGIC = 0x464F5250
+PROF_VERSION = 1
+NM = "arm-none-eabi-nm"
+
+
+def parse_dump(data, offset):
+    magic, version, tasks, buckets = struct.unpack_from("<4I", data, offset)
+    if magic != PROF_MAGIC or version != PROF_VERSION:
+        return None
+    offset += 16
+    hists = []
+    for _ in range(tasks):
+        tid, base, shift, samples, other = struct.unpack_from("<5I", data, offset)
+        offset += 20
+        counts = struct.unpack_from("<%dI" % buckets, data, offset)
+        offset += 4 * buckets
+        hists.append((tid, base, shift, samples, other, counts))
+    return hists
+
+
+def last_dump(data):
+    magic = struct.pack("<I", PROF_MAGIC)
+    dump = None
+    pos = data.find(magic)
+    while pos >= 0:
+        try:
+            dump = parse_dump(data, pos) or dump
+        except struct.error:
+            break  # Truncated dump at the end of the capture
+        pos = data.find(magic, pos + 4)
+    return dump
+
+
+def load_symbols(elf):
+    out = subprocess.run([NM, "-n", "--defined-only", elf],
+                         capture_output=True, text=True, check=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[1] in "tTwW":
+            addrs.append(int(fields[0], 16))
+            names.append(fields[2])
+    return addrs, names
+
+
+def symbolize(addrs, names, pc):
+    i = bisect.bisect_right(addrs, pc) - 1
+    return names[i] if i >= 0 else "0x%08x" % pc
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        dump = last_dump(f.read())
+    if dump is None:
+        sys.exit("No profiler dump found in %s" % sys.argv[1])
+    addrs, names = load_symbols(sys.argv[2])
+
+    for tid, base, shift, samples, other, counts in dump:
+        print("TASK%d: %d samples, %d outside its text" % (tid, samples, other))
+        per_symbol = {}
+        for i, count in enumerate(counts):
+            if count:
+                name = symbolize(addrs, names, base + (i << shift))
+                per_symbol[name] = per_symbol.get(name, 0) + count
+        for name, count in sorted(per_symbol.items(), key=lambda kv: -kv[1]):
+            print("  %6.2f%%  %8d  %s" % (100.0 * count / max(samples, 1), count, name))
+
+
+if __name__ == "__main__":
+    main()